@@ -0,0 +1,125 @@
+// Allocator calls of one md_parse() of a link-heavy document: every paragraph has inline links with
+// backslash escapes in the destination and title, and multi-line reference definitions with titles
+// and labels that md4c has to merge across lines. Each of those used to be a malloc and free of its own,
+// until md4c allocated them from per-parse arenas.
+//
+// Build with `scons bench`, then run:
+//   bin/bench/bench_allocations [--paragraphs N] [--definitions N] [--max-calls N]
+// `scons bench_check` runs it with the defaults. It fails when the count exceeds --max-calls, which for the
+// default document defaults to DEFAULT_MAX_CALLS, so a change that brings back allocations per link fails it.
+// md4c's arrays still grow with the document, so other sizes only get a limit when one is given.
+//
+// Only md4c's allocator is counted, through MD_PARSER::allocator, so the number doesn't depend on a
+// sink. The document is generated, so the counts of two md4c versions can be compared directly: build
+// this file against the src/md4c.c and src/md4c.h of each and run both with the same arguments.
+
+#include "md4c.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// 43 when this was set, the margin is for a few more arena blocks or array growths
+static const uint64_t DEFAULT_MAX_CALLS = 64;
+static const int DEFAULT_PARAGRAPHS = 2000;
+static const int DEFAULT_DEFINITIONS = 50;
+
+static uint64_t allocation_count = 0;
+
+static void* counting_malloc(size_t size, void*) {
+	allocation_count++;
+	return malloc(size);
+}
+static void* counting_realloc(void* ptr, size_t size, void*) {
+	allocation_count++;
+	return realloc(ptr, size);
+}
+static void counting_free(void* ptr, void*) {
+	free(ptr);
+}
+
+static const MD_ALLOCATOR COUNTING_ALLOCATOR = { counting_malloc, counting_realloc, counting_free, nullptr };
+
+static int ignore_block(MD_BLOCKTYPE, void*, void*) {
+	return 0;
+}
+static int ignore_span(MD_SPANTYPE, void*, void*) {
+	return 0;
+}
+static int ignore_text(MD_TEXTTYPE, const MD_CHAR*, MD_SIZE, void*) {
+	return 0;
+}
+
+static std::string make_document(int paragraphs, int definitions) {
+	std::string text;
+	char line[512];
+	for (int i = 0; i < paragraphs; i++) {
+		snprintf(line, sizeof(line),
+				"Paragraph %d links to [the \\*escaped\\* page](/docs/a\\_b\\_%d.md \"Title with \\\"quotes\\\" %d\") "
+				"and [definition %d][def\nlabel %d], see the notes.\n\n",
+				i, i, i, i, i % definitions);
+		text += line;
+	}
+	for (int i = 0; i < definitions; i++) {
+		snprintf(line, sizeof(line), "[def\nlabel %d]:\n  /refs/path\\_%d\n  \"Multi-line\n  title %d\"\n\n", i, i, i);
+		text += line;
+	}
+	return text;
+}
+
+int main(int argc, char** argv) {
+	int paragraphs = DEFAULT_PARAGRAPHS;
+	int definitions = DEFAULT_DEFINITIONS;
+	long long max_calls = -1;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--paragraphs" && i + 1 < argc) {
+			paragraphs = atoi(argv[++i]);
+		} else if (arg == "--definitions" && i + 1 < argc) {
+			definitions = atoi(argv[++i]);
+		} else if (arg == "--max-calls" && i + 1 < argc) {
+			max_calls = atoll(argv[++i]);
+		} else {
+			fprintf(stderr, "Usage: %s [--paragraphs N] [--definitions N] [--max-calls N]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (paragraphs < 0 || definitions < 1) {
+		fprintf(stderr, "Needs at least one definition\n");
+		return 1;
+	}
+
+	std::string text = make_document(paragraphs, definitions);
+	// Set field by field, so this builds against older md4c.h versions too
+	MD_PARSER parser = {};
+	parser.flags = MD_FLAG_TABLES | MD_FLAG_STRIKETHROUGH | MD_FLAG_WIKILINKS | MD_FLAG_UNDERLINE;
+	parser.enter_block = ignore_block;
+	parser.leave_block = ignore_block;
+	parser.enter_span = ignore_span;
+	parser.leave_span = ignore_span;
+	parser.text = ignore_text;
+	parser.allocator = &COUNTING_ALLOCATOR;
+
+	auto start = std::chrono::steady_clock::now();
+	int err = md_parse(text.data(), (MD_SIZE)text.size(), &parser, nullptr);
+	double usec = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	if (err != 0) {
+		fprintf(stderr, "md_parse failed with %d\n", err);
+		return 1;
+	}
+	printf("%zu bytes, %d paragraphs, %d reference definitions\n", text.size(), paragraphs, definitions);
+	printf("allocator calls  %llu\n", (unsigned long long)allocation_count);
+	printf("parse time       %.0f us\n", usec);
+
+	if (max_calls < 0 && paragraphs == DEFAULT_PARAGRAPHS && definitions == DEFAULT_DEFINITIONS) {
+		max_calls = (long long)DEFAULT_MAX_CALLS;
+	}
+	if (max_calls >= 0 && allocation_count > (uint64_t)max_calls) {
+		fprintf(stderr, "FAILED: %llu allocator calls, at most %lld expected\n", (unsigned long long)allocation_count, max_calls);
+		return 1;
+	}
+	return 0;
+}
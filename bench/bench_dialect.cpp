@@ -0,0 +1,140 @@
+// Compares md4c's generic build against the build specialized for the extension's dialect
+// (see src/md4c_dialects.h), and checks both report exactly the same parse events. The result
+// decides whether the extension is worth building with `scons md_dialect=yes`.
+//
+// Build with `scons bench`, then run from the repository root:
+//   bin/bench/bench_dialect [file.md ...]
+// Without arguments every bench/corpus/*.md is measured. The total is over one parse of each file,
+// so larger files weigh more.
+
+#include "md4c_dialects.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef int (*ParseFunction)(const MD_CHAR*, MD_SIZE, const MD_PARSER*, void*);
+
+// FNV-1a over every callback and its arguments
+struct EventHash {
+	uint64_t value = 14695981039346656037ull;
+
+	void add(const void* data, size_t size) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++) {
+			value ^= bytes[i];
+			value *= 1099511628211ull;
+		}
+	}
+	void add_int(int number) { add(&number, sizeof(number)); }
+};
+
+static int hash_enter_block(MD_BLOCKTYPE type, void*, void* userdata) {
+	((EventHash*)userdata)->add_int(100 + type);
+	return 0;
+}
+static int hash_leave_block(MD_BLOCKTYPE type, void*, void* userdata) {
+	((EventHash*)userdata)->add_int(200 + type);
+	return 0;
+}
+static int hash_enter_span(MD_SPANTYPE type, void*, void* userdata) {
+	((EventHash*)userdata)->add_int(300 + type);
+	return 0;
+}
+static int hash_leave_span(MD_SPANTYPE type, void*, void* userdata) {
+	((EventHash*)userdata)->add_int(400 + type);
+	return 0;
+}
+static int hash_text(MD_TEXTTYPE type, const MD_CHAR* text, MD_SIZE size, void* userdata) {
+	((EventHash*)userdata)->add_int(500 + type);
+	((EventHash*)userdata)->add(text, size);
+	return 0;
+}
+
+static int noop_block(MD_BLOCKTYPE, void*, void*) { return 0; }
+static int noop_span(MD_SPANTYPE, void*, void*) { return 0; }
+static int noop_text(MD_TEXTTYPE, const MD_CHAR*, MD_SIZE, void*) { return 0; }
+
+static uint64_t hash_events(ParseFunction parse, const std::string& text) {
+	MD_PARSER parser = { 0, MD4C_DIALECT_GODOT_FLAGS, hash_enter_block, hash_leave_block, hash_enter_span, hash_leave_span, hash_text, nullptr, nullptr, nullptr, nullptr };
+	EventHash hash;
+	parse(text.data(), (MD_SIZE)text.size(), &parser, &hash);
+	return hash.value;
+}
+
+static double time_parse(ParseFunction parse, const std::string& text, int iterations) {
+	MD_PARSER parser = { 0, MD4C_DIALECT_GODOT_FLAGS, noop_block, noop_block, noop_span, noop_span, noop_text, nullptr, nullptr, nullptr, nullptr };
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		parse(text.data(), (MD_SIZE)text.size(), &parser, nullptr);
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++)
+		paths.push_back(argv[i]);
+	if (paths.empty()) {
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator("bench/corpus", error)) {
+			if (entry.path().extension() == ".md")
+				paths.push_back(entry.path().string());
+		}
+		std::sort(paths.begin(), paths.end());
+	}
+	if (paths.empty()) {
+		fprintf(stderr, "No markdown files in bench/corpus, run from the repository root\n");
+		return 1;
+	}
+
+	int failures = 0;
+	size_t total_bytes = 0;
+	double total_generic_ns = 0.0;
+	double total_dialect_ns = 0.0;
+	for (const std::string& path : paths) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			fprintf(stderr, "Cannot open %s\n", path.c_str());
+			return 1;
+		}
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		const std::string text = buffer.str();
+
+		bool same = hash_events(md_parse_generic, text) == hash_events(md_parse_godot_dialect, text);
+		if (!same)
+			failures++;
+
+		// Roughly 5 MB of input per measurement
+		int iterations = (int)(5000000 / (text.size() + 1)) + 1;
+		// Interleaved rounds, keeping the best of each, so scheduling noise affects both builds alike
+		double generic_ns = 0.0;
+		double dialect_ns = 0.0;
+		for (int round = 0; round < 15; round++) {
+			double ns = time_parse(md_parse_generic, text, iterations);
+			generic_ns = (round == 0 || ns < generic_ns) ? ns : generic_ns;
+			ns = time_parse(md_parse_godot_dialect, text, iterations);
+			dialect_ns = (round == 0 || ns < dialect_ns) ? ns : dialect_ns;
+		}
+		total_bytes += text.size();
+		total_generic_ns += generic_ns;
+		total_dialect_ns += dialect_ns;
+		printf("%s (%zu bytes): events %s\n", path.c_str(), text.size(), same ? "identical" : "DIFFER");
+		printf("  generic      %8.1f us/parse  %6.1f MB/s\n", generic_ns / 1000.0, text.size() / generic_ns * 1000.0);
+		printf("  specialized  %8.1f us/parse  %6.1f MB/s  (%+.1f%%)\n", dialect_ns / 1000.0, text.size() / dialect_ns * 1000.0,
+				(generic_ns / dialect_ns - 1.0) * 100.0);
+	}
+	printf("total (%zu files, %zu bytes)\n", paths.size(), total_bytes);
+	printf("  generic      %6.1f MB/s\n", total_bytes / total_generic_ns * 1000.0);
+	printf("  specialized  %6.1f MB/s  (%+.1f%%)\n", total_bytes / total_dialect_ns * 1000.0, (total_generic_ns / total_dialect_ns - 1.0) * 100.0);
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+// Throughput of md4c plus the renderer into a MDRecordingSink, over a fixed corpus that covers the
+// CommonMark constructs, prose, tables, links, deep nesting and CJK text.
+//
+// Build with `scons bench` (needs no godot-cpp), then run from the repository root:
+//   bin/bench/bench_throughput [--corpus bench/corpus] [--json results.json]
+//
+// Each corpus file is repeated to at least 256 KB, and every measurement keeps the best of several
+// rounds. Reported per file:
+//   mb_per_s       source bytes rendered per second, in millions
+//   virtual_mb_per_s  the same through MDRenderer, which calls the sink through MDRenderSink's virtual
+//                  functions instead of the inlined MDTypedRenderer<MDRecordingSink>
+//   ns_per_event   render time divided by md4c's block, span and text callbacks
+//   allocs_per_kb  heap allocations of one render with a fresh sink, through md4c's allocator and
+//                  C++ operator new, per 1024 source bytes
+// The JSON has a fixed layout, so results of two versions can be compared with a plain diff.
+
+#include "md_recording_sink.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char* CORPUS[] = { "commonmark", "prose", "tables", "links", "nested", "cjk" };
+
+static const size_t MIN_DOCUMENT_SIZE = 256 * 1024;
+static const size_t BYTES_PER_ROUND = 8 * 1024 * 1024;
+static const int ROUNDS = 5;
+
+static uint64_t allocation_count = 0;
+
+void* operator new(size_t size) {
+	allocation_count++;
+	void* ptr = malloc(size > 0 ? size : 1);
+	if (ptr == nullptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+static void* counting_malloc(size_t size, void*) {
+	allocation_count++;
+	return malloc(size);
+}
+static void* counting_realloc(void* ptr, size_t size, void*) {
+	allocation_count++;
+	return realloc(ptr, size);
+}
+static void counting_free(void* ptr, void*) {
+	free(ptr);
+}
+
+static const MD_ALLOCATOR COUNTING_ALLOCATOR = { counting_malloc, counting_realloc, counting_free, nullptr };
+
+static int count_block(MD_BLOCKTYPE, void*, void* userdata) {
+	(*(uint64_t*)userdata)++;
+	return 0;
+}
+static int count_span(MD_SPANTYPE, void*, void* userdata) {
+	(*(uint64_t*)userdata)++;
+	return 0;
+}
+static int count_text(MD_TEXTTYPE, const MD_CHAR*, MD_SIZE, void* userdata) {
+	(*(uint64_t*)userdata)++;
+	return 0;
+}
+
+struct CorpusResult {
+	std::string name;
+	size_t bytes = 0;
+	uint64_t events = 0;
+	double mb_per_s = 0.0;
+	double virtual_mb_per_s = 0.0;
+	double ns_per_event = 0.0;
+	double allocs_per_kb = 0.0;
+};
+
+static uint64_t count_events(const std::string& text) {
+	MD_PARSER parser = { 0, MDRenderer::PARSER_FLAGS, count_block, count_block, count_span, count_span, count_text, nullptr, nullptr, nullptr, nullptr, 0, 0 };
+	uint64_t events = 0;
+	md_parse(text.data(), (MD_SIZE)text.size(), &parser, &events);
+	return events;
+}
+
+// Renders the way MDTextLabel does, minus the engine
+static int render(const MDRenderStyle& style, MDRecordingSink& sink, const std::string& text, const MD_ALLOCATOR* allocator) {
+	MDTypedRenderer<MDRecordingSink> renderer(style, sink, allocator);
+	renderer.set_coalesce_text(true);
+	return renderer.render(text.data(), (MD_SIZE)text.size());
+}
+
+static int render_virtual(const MDRenderStyle& style, MDRenderSink& sink, const std::string& text) {
+	MDRenderer renderer(style, sink);
+	renderer.set_coalesce_text(true);
+	return renderer.render(text.data(), (MD_SIZE)text.size());
+}
+
+static bool measure(const std::string& name, const std::string& source, CorpusResult& r_result) {
+	std::string text = source;
+	while (text.size() < MIN_DOCUMENT_SIZE)
+		text += "\n\n" + source;
+
+	MDRenderStyle style;
+	r_result.name = name;
+	r_result.bytes = text.size();
+	r_result.events = count_events(text);
+
+	uint64_t allocations_before = allocation_count;
+	{
+		MDRecordingSink cold_sink;
+		if (render(style, cold_sink, text, &COUNTING_ALLOCATOR) != MD_OK)
+			return false;
+	}
+	r_result.allocs_per_kb = (double)(allocation_count - allocations_before) * 1024.0 / (double)text.size();
+
+	MDRecordingSink sink;
+	int iterations = (int)(BYTES_PER_ROUND / text.size()) + 1;
+	// Interleaved rounds, keeping the best of each, so scheduling noise affects both dispatches alike
+	double best_ns = 0.0;
+	double best_virtual_ns = 0.0;
+	for (int round = 0; round < ROUNDS; round++) {
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			sink.clear();
+			render(style, sink, text, nullptr);
+		}
+		auto end = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+		best_ns = (round == 0 || ns < best_ns) ? ns : best_ns;
+
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			sink.clear();
+			render_virtual(style, sink, text);
+		}
+		end = std::chrono::steady_clock::now();
+		ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+		best_virtual_ns = (round == 0 || ns < best_virtual_ns) ? ns : best_virtual_ns;
+	}
+	r_result.mb_per_s = (double)text.size() / best_ns * 1000.0;
+	r_result.virtual_mb_per_s = (double)text.size() / best_virtual_ns * 1000.0;
+	r_result.ns_per_event = r_result.events > 0 ? best_ns / (double)r_result.events : 0.0;
+	return true;
+}
+
+static bool write_json(const char* path, const std::vector<CorpusResult>& results) {
+	FILE* file = fopen(path, "w");
+	if (file == nullptr)
+		return false;
+	fprintf(file, "{\n  \"benchmark\": \"bench_throughput\",\n  \"parser_flags\": %u,\n  \"corpus\": [\n", MDRenderer::PARSER_FLAGS);
+	for (size_t i = 0; i < results.size(); i++) {
+		const CorpusResult& r = results[i];
+		fprintf(file, "    { \"name\": \"%s\", \"bytes\": %zu, \"events\": %llu, \"mb_per_s\": %.2f, \"virtual_mb_per_s\": %.2f, \"ns_per_event\": %.2f, \"allocs_per_kb\": %.3f }%s\n",
+				r.name.c_str(), r.bytes, (unsigned long long)r.events, r.mb_per_s, r.virtual_mb_per_s, r.ns_per_event, r.allocs_per_kb, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	std::string corpus_dir = "bench/corpus";
+	const char* json_path = nullptr;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--corpus" && i + 1 < argc) {
+			corpus_dir = argv[++i];
+		} else if (arg == "--json" && i + 1 < argc) {
+			json_path = argv[++i];
+		} else {
+			fprintf(stderr, "Usage: %s [--corpus DIR] [--json FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<CorpusResult> results;
+	printf("%-12s %10s %10s %10s %12s %12s %12s\n", "corpus", "bytes", "events", "MB/s", "virtual MB/s", "ns/event", "allocs/KB");
+	for (const char* name : CORPUS) {
+		std::string path = corpus_dir + "/" + name + ".md";
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			fprintf(stderr, "Cannot open %s\n", path.c_str());
+			return 1;
+		}
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+
+		CorpusResult result;
+		if (!measure(name, buffer.str(), result)) {
+			fprintf(stderr, "Rendering %s failed\n", path.c_str());
+			return 1;
+		}
+		printf("%-12s %10zu %10llu %10.2f %12.2f %12.2f %12.3f\n", name, result.bytes, (unsigned long long)result.events,
+				result.mb_per_s, result.virtual_mb_per_s, result.ns_per_event, result.allocs_per_kb);
+		results.push_back(result);
+	}
+
+	if (json_path != nullptr && !write_json(json_path, results)) {
+		fprintf(stderr, "Cannot write %s\n", json_path);
+		return 1;
+	}
+	return 0;
+}
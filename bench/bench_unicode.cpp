@@ -0,0 +1,212 @@
+// Checks md4c's generated two-stage Unicode tables against the range maps they are built from,
+// then compares lookup speed of both over a multilingual corpus, and times a full md_parse() of it.
+//
+// Build with `scons bench`, which also generates src/gen/md4c_unicode.gen.h, then run from the
+// repository root:
+//   bin/bench/bench_unicode bench/corpus/multilingual.md
+
+#include "md4c.h"
+#include "md4c_unicode_maps.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gen/md4c_unicode.gen.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define SIZEOF_ARRAY(a) (sizeof(a) / sizeof(a[0]))
+
+struct FoldInfo {
+	unsigned codepoints[3];
+	unsigned n_codepoints;
+};
+
+// md4c's lookups before the tables were generated
+static int reference_bsearch(unsigned codepoint, const unsigned* map, size_t map_size) {
+	int beg = 0;
+	int end = (int)map_size - 1;
+	while (beg <= end) {
+		int pivot_beg = (beg + end) / 2;
+		int pivot_end = pivot_beg;
+		if (map[pivot_end] & 0x40000000)
+			pivot_end++;
+		if (map[pivot_beg] & 0x80000000)
+			pivot_beg--;
+
+		if (codepoint < (map[pivot_beg] & 0x00ffffff))
+			end = pivot_beg - 1;
+		else if (codepoint > (map[pivot_end] & 0x00ffffff))
+			beg = pivot_end + 1;
+		else
+			return pivot_beg;
+	}
+	return -1;
+}
+
+static bool reference_is_whitespace(unsigned codepoint) {
+	return reference_bsearch(codepoint, WHITESPACE_MAP, SIZEOF_ARRAY(WHITESPACE_MAP)) >= 0;
+}
+
+static bool reference_is_punct(unsigned codepoint) {
+	return reference_bsearch(codepoint, PUNCT_MAP, SIZEOF_ARRAY(PUNCT_MAP)) >= 0;
+}
+
+static void reference_fold(unsigned codepoint, FoldInfo* info) {
+	static const struct {
+		const unsigned* map;
+		const unsigned* data;
+		size_t map_size;
+		unsigned n_codepoints;
+	} FOLD_MAP_LIST[] = {
+		{ FOLD_MAP_1, FOLD_MAP_1_DATA, SIZEOF_ARRAY(FOLD_MAP_1), 1 },
+		{ FOLD_MAP_2, FOLD_MAP_2_DATA, SIZEOF_ARRAY(FOLD_MAP_2), 2 },
+		{ FOLD_MAP_3, FOLD_MAP_3_DATA, SIZEOF_ARRAY(FOLD_MAP_3), 3 }
+	};
+
+	for (size_t i = 0; i < SIZEOF_ARRAY(FOLD_MAP_LIST); i++) {
+		int index = reference_bsearch(codepoint, FOLD_MAP_LIST[i].map, FOLD_MAP_LIST[i].map_size);
+		if (index < 0)
+			continue;
+		unsigned n_codepoints = FOLD_MAP_LIST[i].n_codepoints;
+		const unsigned* map = FOLD_MAP_LIST[i].map;
+		const unsigned* codepoints = FOLD_MAP_LIST[i].data + (index * n_codepoints);
+		memcpy(info->codepoints, codepoints, sizeof(unsigned) * n_codepoints);
+		info->n_codepoints = n_codepoints;
+		if (map[index] != codepoint) {
+			if ((map[index] & 0x00ffffff) + 1 == codepoints[0])
+				info->codepoints[0] = codepoint + ((codepoint & 0x1) == (map[index] & 0x1) ? 1 : 0);
+			else
+				info->codepoints[0] += (codepoint - (map[index] & 0x00ffffff));
+		}
+		return;
+	}
+	info->codepoints[0] = codepoint;
+	info->n_codepoints = 1;
+}
+
+// Same as md4c.c
+static const MD_UNICODE_RECORD* table_record(unsigned codepoint) {
+	if (codepoint > 0x10ffff)
+		return &MD_UNICODE_RECORDS[0];
+	return &MD_UNICODE_RECORDS[MD_UNICODE_STAGE2[((unsigned)MD_UNICODE_STAGE1[codepoint >> MD_UNICODE_SHIFT] << MD_UNICODE_SHIFT) | (codepoint & MD_UNICODE_MASK)]];
+}
+
+static void table_fold(unsigned codepoint, FoldInfo* info) {
+	const MD_UNICODE_RECORD* record = table_record(codepoint);
+	info->n_codepoints = record->n_codepoints;
+	if (record->n_codepoints == 1) {
+		info->codepoints[0] = (unsigned)((int)codepoint + record->codepoints[0]);
+		return;
+	}
+	for (unsigned i = 0; i < record->n_codepoints; i++)
+		info->codepoints[i] = (unsigned)record->codepoints[i];
+}
+
+static int verify_tables() {
+	int mismatches = 0;
+	// md4c answers ASCII without the tables, so they only need to agree above it
+	for (unsigned cp = 0x80; cp <= 0x10ffff + 1; cp++) {
+		const MD_UNICODE_RECORD* record = table_record(cp);
+		FoldInfo expected, actual;
+		reference_fold(cp, &expected);
+		table_fold(cp, &actual);
+		bool same = reference_is_whitespace(cp) == ((record->flags & MD_UNICODE_FLAG_WHITESPACE) != 0) &&
+				reference_is_punct(cp) == ((record->flags & MD_UNICODE_FLAG_PUNCT) != 0) &&
+				expected.n_codepoints == actual.n_codepoints &&
+				memcmp(expected.codepoints, actual.codepoints, sizeof(unsigned) * expected.n_codepoints) == 0;
+		if (!same && mismatches++ < 10)
+			printf("mismatch at U+%04X\n", cp);
+	}
+	return mismatches;
+}
+
+static std::vector<unsigned> decode_utf8(const std::string& text) {
+	std::vector<unsigned> codepoints;
+	for (size_t i = 0; i < text.size();) {
+		unsigned char c = (unsigned char)text[i];
+		int length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : 4;
+		unsigned cp = length == 1 ? c : (c & (0x7f >> length));
+		for (int k = 1; k < length && i + k < text.size(); k++)
+			cp = (cp << 6) | ((unsigned char)text[i + k] & 0x3f);
+		codepoints.push_back(cp);
+		i += length;
+	}
+	return codepoints;
+}
+
+template <typename F>
+static double time_ns(int iterations, F f) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+static int noop_block(MD_BLOCKTYPE, void*, void*) { return 0; }
+static int noop_span(MD_SPANTYPE, void*, void*) { return 0; }
+static int noop_text(MD_TEXTTYPE, const MD_CHAR*, MD_SIZE, void*) { return 0; }
+
+int main(int argc, char** argv) {
+	const char* path = argc > 1 ? argv[1] : "bench/corpus/multilingual.md";
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		fprintf(stderr, "Cannot open %s\n", path);
+		return 1;
+	}
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	const std::string text = buffer.str();
+
+	int mismatches = verify_tables();
+	printf("tables: %s (%d mismatches)\n", mismatches == 0 ? "match the range maps" : "DIFFER", mismatches);
+
+	// Only non-ASCII codepoints reach the tables in md4c
+	std::vector<unsigned> codepoints;
+	for (unsigned cp : decode_utf8(text)) {
+		if (cp > 0x7f)
+			codepoints.push_back(cp);
+	}
+	const int iterations = 2000;
+	volatile unsigned sink = 0;
+
+	double bsearch_ns = time_ns(iterations, [&]() {
+		unsigned acc = 0;
+		for (unsigned cp : codepoints) {
+			FoldInfo info;
+			reference_fold(cp, &info);
+			acc += reference_is_whitespace(cp) + reference_is_punct(cp) + info.codepoints[0];
+		}
+		sink = sink + acc;
+	});
+	double table_ns = time_ns(iterations, [&]() {
+		unsigned acc = 0;
+		for (unsigned cp : codepoints) {
+			FoldInfo info;
+			table_fold(cp, &info);
+			const MD_UNICODE_RECORD* record = table_record(cp);
+			acc += (record->flags & MD_UNICODE_FLAG_WHITESPACE) + (record->flags & MD_UNICODE_FLAG_PUNCT) + info.codepoints[0];
+		}
+		sink = sink + acc;
+	});
+	double lookups = (double)codepoints.size() * iterations;
+	printf("%zu non-ASCII codepoints, whitespace + punct + fold per codepoint:\n", codepoints.size());
+	printf("  binary search  %6.2f ns/codepoint\n", bsearch_ns / lookups);
+	printf("  two-stage      %6.2f ns/codepoint (%.1fx)\n", table_ns / lookups, bsearch_ns / table_ns);
+
+	MD_PARSER parser = { 0, MD_FLAG_TABLES | MD_FLAG_STRIKETHROUGH | MD_FLAG_UNDERLINE, noop_block, noop_block, noop_span, noop_span, noop_text, nullptr, nullptr, nullptr };
+	const int parse_iterations = 2000;
+	double parse_ns = time_ns(parse_iterations, [&]() {
+		md_parse(text.data(), (MD_SIZE)text.size(), &parser, nullptr);
+	});
+	printf("md_parse: %zu bytes, %.1f us/parse, %.1f MB/s\n", text.size(), parse_ns / parse_iterations / 1000.0,
+			text.size() * (double)parse_iterations / (parse_ns / 1e9) / 1e6);
+
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// Training run for profile-guided optimization of the extension. Renders the benchmark corpus through
+// the same md4c and renderer objects that are linked into the extension, so the profile it records
+// applies to them. Built and run by SConstruct, from the repository root:
+//   scons target=template_release md_pgo=generate md_lto=yes pgo_train
+//   scons target=template_release md_pgo=use md_lto=yes
+// Run by hand, it also reports the speed of the build it is part of:
+//   bin/pgo/md_pgo_driver [--corpus bench/corpus] [--rounds N]
+//
+// Covers the BBCode sink (MD2BB, MDBatch) with and without text coalescing as MDTextLabel uses it, and
+// plain text extraction. MDTextLabel's own sink needs the engine, so its renderer instantiation is the
+// one hot path left out of the profile.
+
+#include "md_bbcode_sink.h"
+#include "md_plain_text.h"
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static const char* CORPUS[] = { "commonmark", "prose", "tables", "links", "nested", "cjk" };
+
+static const size_t MIN_DOCUMENT_SIZE = 256 * 1024;
+
+int main(int argc, char** argv) {
+	std::string corpus_dir = "bench/corpus";
+	int rounds = 20;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--corpus" && i + 1 < argc) {
+			corpus_dir = argv[++i];
+		} else if (arg == "--rounds" && i + 1 < argc) {
+			rounds = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "Usage: %s [--corpus DIR] [--rounds N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	MDRenderStyle style;
+	MDBBCodeSink sink;
+	MDStringBuilder plain_text;
+	double total_bytes = 0.0;
+	double total_seconds = 0.0;
+	printf("%-12s %10s %10s\n", "corpus", "bytes", "MB/s");
+	for (const char* name : CORPUS) {
+		std::string path = corpus_dir + "/" + name + ".md";
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			fprintf(stderr, "Cannot open %s\n", path.c_str());
+			return 1;
+		}
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		std::string source = buffer.str();
+		std::string text = source;
+		while (text.size() < MIN_DOCUMENT_SIZE)
+			text += "\n\n" + source;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int round = 0; round < rounds; round++) {
+			for (int coalesce = 0; coalesce < 2; coalesce++) {
+				sink.clear();
+				MDTypedRenderer<MDBBCodeSink> renderer(style, sink);
+				renderer.set_coalesce_text(coalesce != 0);
+				if (renderer.render(text.data(), (MD_SIZE)text.size()) != MD_OK) {
+					fprintf(stderr, "Rendering %s failed\n", path.c_str());
+					return 1;
+				}
+			}
+			plain_text.clear();
+			MDPlainTextRenderer plain_text_renderer(plain_text);
+			plain_text_renderer.render(text.data(), (MD_SIZE)text.size());
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double bytes = (double)text.size() * rounds * 3;
+		printf("%-12s %10zu %10.2f\n", name, text.size(), bytes / seconds / 1e6);
+		total_bytes += bytes;
+		total_seconds += seconds;
+	}
+	printf("%-12s %10s %10.2f\n", "total", "", total_bytes / total_seconds / 1e6);
+	return 0;
+}
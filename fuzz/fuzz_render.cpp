@@ -0,0 +1,168 @@
+// libFuzzer target for md4c and the renderer. Players can author markdown, so besides crashes this
+// flags any input that costs too much time or memory for its size, which is how super-linear paths
+// show up. Built with `scons fuzz` on Linux with clang, then run from the repository root:
+//   bin/fuzz/fuzz_render -max_len=65536 fuzz/work fuzz/corpus/seed fuzz/corpus/slow
+// where fuzz/work collects the new inputs. make_slow_corpus.py can write more seeds for it.
+// `scons fuzz_replay` runs the checked in corpora once without fuzzing. Built with MD_FUZZ_STANDALONE,
+// e.g. with gcc, that works without libFuzzer too.
+//
+// Every input is rendered into a MDRecordingSink, which is replayed onto a MDBBCodeSink, then also
+// converted to plain text. Thresholds, overridable through environment variables:
+//   MD_FUZZ_MAX_NS_PER_BYTE      time of both renders per input byte, on top of a fixed 2 ms (default 20000)
+//   MD_FUZZ_MAX_BYTES_PER_BYTE   peak md4c heap per input byte, on top of a fixed 64 KB (default 256)
+//   MD_FUZZ_MAX_ALLOCS_PER_BYTE  md4c allocations, reallocations included, per input byte, on top of a
+//                                fixed 256 (default 1)
+// The time threshold is generous because sanitizers and coverage slow everything down several times
+// over; a quadratic path still exceeds it by orders of magnitude on a few tens of KB.
+// When fuzzing finds a slow input, minimize it with -minimize_crash=1 -runs=10000 and, once it is fixed,
+// commit the result to fuzz/corpus/slow.
+
+#include "md_bbcode_sink.h"
+#include "md_plain_text.h"
+#include "md_recording_sink.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+static const uint64_t BASE_NS = 2000000;
+static const uint64_t BASE_BYTES = 64 * 1024;
+static const uint64_t BASE_ALLOCATIONS = 256;
+
+static uint64_t max_ns_per_byte = 20000;
+static uint64_t max_bytes_per_byte = 256;
+static uint64_t max_allocations_per_byte = 1;
+
+// Heap in use by md4c and the renderer's text runs. Each block is prefixed with its size so frees can be counted
+static size_t live_bytes = 0;
+static size_t peak_bytes = 0;
+// Calls to malloc and realloc since the input started
+static uint64_t allocations = 0;
+
+struct alignas(16) AllocationHeader {
+	size_t size;
+};
+
+static void* tracking_malloc(size_t size, void*) {
+	AllocationHeader* header = (AllocationHeader*)malloc(sizeof(AllocationHeader) + size);
+	if (header == nullptr)
+		return nullptr;
+	header->size = size;
+	allocations++;
+	live_bytes += size;
+	peak_bytes = live_bytes > peak_bytes ? live_bytes : peak_bytes;
+	return header + 1;
+}
+
+static void tracking_free(void* ptr, void*) {
+	if (ptr == nullptr)
+		return;
+	AllocationHeader* header = (AllocationHeader*)ptr - 1;
+	live_bytes -= header->size;
+	free(header);
+}
+
+static void* tracking_realloc(void* ptr, size_t size, void*) {
+	if (ptr == nullptr)
+		return tracking_malloc(size, nullptr);
+	AllocationHeader* header = (AllocationHeader*)ptr - 1;
+	size_t old_size = header->size;
+	header = (AllocationHeader*)realloc(header, sizeof(AllocationHeader) + size);
+	if (header == nullptr)
+		return nullptr;
+	header->size = size;
+	allocations++;
+	live_bytes = live_bytes - old_size + size;
+	peak_bytes = live_bytes > peak_bytes ? live_bytes : peak_bytes;
+	return header + 1;
+}
+
+static const MD_ALLOCATOR TRACKING_ALLOCATOR = { tracking_malloc, tracking_realloc, tracking_free, nullptr };
+
+static uint64_t threshold_from_env(const char* name, uint64_t fallback) {
+	const char* value = getenv(name);
+	return value != nullptr ? strtoull(value, nullptr, 10) : fallback;
+}
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+	max_ns_per_byte = threshold_from_env("MD_FUZZ_MAX_NS_PER_BYTE", max_ns_per_byte);
+	max_bytes_per_byte = threshold_from_env("MD_FUZZ_MAX_BYTES_PER_BYTE", max_bytes_per_byte);
+	max_allocations_per_byte = threshold_from_env("MD_FUZZ_MAX_ALLOCS_PER_BYTE", max_allocations_per_byte);
+	return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	const MD_CHAR* text = (const MD_CHAR*)data;
+	MDRenderStyle style;
+	MDRecordingSink recording;
+	peak_bytes = live_bytes;
+	allocations = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		// Its text run buffer comes from the same allocator, and is freed with it
+		MDTypedRenderer<MDRecordingSink> renderer(style, recording, &TRACKING_ALLOCATOR);
+		renderer.set_coalesce_text((size & 1) != 0);
+		renderer.render(text, (MD_SIZE)size);
+	}
+	uint64_t render_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+	MDBBCodeSink bbcode;
+	recording.replay(bbcode);
+
+	start = std::chrono::steady_clock::now();
+	MDStringBuilder plain_text;
+	MDPlainTextRenderer plain_text_renderer(plain_text, &TRACKING_ALLOCATOR);
+	plain_text_renderer.render(text, (MD_SIZE)size);
+	render_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+	if (live_bytes != 0) {
+		fprintf(stderr, "md4c leaked %zu bytes\n", live_bytes);
+		abort();
+	}
+	uint64_t max_ns = BASE_NS + max_ns_per_byte * size;
+	if (render_ns > max_ns) {
+		fprintf(stderr, "Slow input: %zu bytes rendered twice in %llu us, over the %llu us threshold\n",
+				size, (unsigned long long)(render_ns / 1000), (unsigned long long)(max_ns / 1000));
+		abort();
+	}
+	uint64_t max_bytes = BASE_BYTES + max_bytes_per_byte * size;
+	if (peak_bytes > max_bytes) {
+		fprintf(stderr, "Memory hungry input: %zu bytes needed %zu bytes of md4c heap, over the %llu byte threshold\n",
+				size, peak_bytes, (unsigned long long)max_bytes);
+		abort();
+	}
+	uint64_t max_allocations = BASE_ALLOCATIONS + max_allocations_per_byte * size;
+	if (allocations > max_allocations) {
+		fprintf(stderr, "Allocation heavy input: %zu bytes made %llu md4c allocations, over the %llu threshold\n",
+				size, (unsigned long long)allocations, (unsigned long long)max_allocations);
+		abort();
+	}
+	return 0;
+}
+
+#ifdef MD_FUZZ_STANDALONE
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// Replays the given files once each, as libFuzzer does when only given files
+int main(int argc, char** argv) {
+	LLVMFuzzerInitialize(&argc, &argv);
+	for (int i = 1; i < argc; i++) {
+		std::ifstream file(argv[i], std::ios::binary);
+		if (!file) {
+			fprintf(stderr, "Cannot open %s\n", argv[i]);
+			return 1;
+		}
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		fprintf(stderr, "Running %s (%zu bytes)\n", argv[i], data.size());
+		LLVMFuzzerTestOneInput(data.data(), data.size());
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,141 @@
+#!/usr/bin/env python
+# Writes inputs that used to be, or easily could be, super-linear for md4c or the renderer, from hand-written
+# patterns. The regression corpus fuzz/corpus/slow is checked in; this only seeds it and a fuzzing run.
+#   python fuzz/make_slow_corpus.py [--sizes 1024,8192,49152] [output directory, default fuzz/work/slow_seeds]
+# Each pattern is written at every size, all under the -max_len the fuzz target is run with. The checked in
+# files are the patterns at 8192 bytes. That is small enough to replay quickly, and large enough that a
+# quadratic path of a few ns per byte pair goes over fuzz_render's time threshold:
+#   python fuzz/make_slow_corpus.py --sizes 8192 fuzz/corpus/slow
+
+import os
+import sys
+
+MAX_LEN = 65536
+SIZES = [1024, 8192, 49152]
+
+
+def repeat(unit):
+    # The unit over and over, on one line
+    return lambda size: unit * (size // len(unit))
+
+
+def lines(make_line):
+    # Lines from make_line(index) until the size is reached
+    def generate(size):
+        result = []
+        total = 0
+        index = 0
+        while True:
+            line = make_line(index) + "\n"
+            if total + len(line) > size:
+                break
+            result.append(line)
+            total += len(line)
+            index += 1
+        return "".join(result)
+
+    return generate
+
+
+def prefixed(prefix, body):
+    return lambda size: prefix + body(size - len(prefix))
+
+
+def backtick_runs(size):
+    result = []
+    total = 0
+    run = 1
+    while total + run + 1 <= size:
+        result.append("`" * run + " ")
+        total += run + 1
+        run = run % 64 + 1
+    return "".join(result)
+
+
+def emphasis_runs(size):
+    unit = "".join("*" * run + "a" for run in range(1, 8))
+    return repeat(unit)(size)
+
+
+def deep_quotes(size):
+    return ">" * (size - 3) + " a\n"
+
+
+def setext_lines(size):
+    return "a\n" + "=" * (size - 3) + "\n"
+
+
+def many_ref_defs(size):
+    # Half definitions, half references to them
+    definitions = lines(lambda i: "[r%d]: /u%d" % (i, i))(size // 2)
+    count = definitions.count("\n")
+    references = []
+    total = len(definitions)
+    for i in range(count):
+        reference = "[r%d] " % i
+        if total + len(reference) + 1 > size:
+            break
+        references.append(reference)
+        total += len(reference)
+    return definitions + "\n" + "".join(references).rstrip() + "\n"
+
+
+def table_pipes(size):
+    header = "a|b\n-|-\n"
+    return header + "|" * (size - len(header) - 1) + "\n"
+
+
+def wide_table(size):
+    # Three rows as wide as the size allows
+    columns = (size // 3 - 2) // 2
+    return "|a" * columns + "\n" + "|-" * columns + "\n" + "|b" * columns + "\n"
+
+
+PATTERNS = {
+    "autolink_lookalikes": repeat("<a:"),
+    "backtick_runs": backtick_runs,
+    "deep_lists": lines(lambda i: "  " * (i % 200) + "- a"),
+    "deep_quotes": deep_quotes,
+    "emphasis_runs": emphasis_runs,
+    "entity_lookalikes": repeat("&#&a"),
+    "hard_breaks": lines(lambda i: "a  "),
+    "html_lookalikes": repeat('<a b="'),
+    "image_brackets": repeat("!["),
+    "link_destinations": prefixed("[a](", lambda size: "(" * (size // 2) + ")" * (size // 2)),
+    "link_titles": prefixed('[a](b "', lambda size: '\\"' * ((size - 2) // 2) + '")'),
+    "many_ref_defs": many_ref_defs,
+    "mixed_emphasis": repeat("*_"),
+    "nested_link_text": lambda size: "[" * (size // 4) + "](u)" * ((size - size // 4) // 4),
+    "open_brackets": repeat("["),
+    "open_brackets_with_text": repeat("[a "),
+    "setext_lines": setext_lines,
+    "staircase_lists": lines(lambda i: " " * (i % 4) + "1. a"),
+    "strikethrough_runs": repeat("~a~~"),
+    "table_pipes": table_pipes,
+    "unclosed_code_spans": repeat("`a ``b "),
+    "unclosed_links": repeat("[a](b "),
+    "undefined_refs": repeat("[a][b]"),
+    "underscore_words": repeat("a_"),
+    "wide_table": wide_table,
+}
+
+
+def main():
+    args = sys.argv[1:]
+    sizes = SIZES
+    if len(args) >= 2 and args[0] == "--sizes":
+        sizes = [int(size) for size in args[1].split(",")]
+        args = args[2:]
+    output_dir = args[0] if args else os.path.join("fuzz", "work", "slow_seeds")
+    os.makedirs(output_dir, exist_ok=True)
+    for name, generate in sorted(PATTERNS.items()):
+        for size in sizes:
+            data = generate(size).encode("utf-8")
+            if len(data) > MAX_LEN:
+                sys.exit("%s at %d bytes is over the %d byte -max_len" % (name, len(data), MAX_LEN))
+            with open(os.path.join(output_dir, "%s_%d.md" % (name, size)), "wb") as file:
+                file.write(data)
+
+
+if __name__ == "__main__":
+    main()
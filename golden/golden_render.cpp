@@ -0,0 +1,538 @@
+// Golden output tests for the renderer. Renders every golden/corpus/*.md through a MDRecordingSink and
+// compares the recorded opcode stream, written out in a canonical text form, with the .golden file
+// next to it. Built and run by `scons golden` from the repository root, or by hand:
+//   bin/golden/golden_render [--corpus golden/corpus] [--update] [name.md ...]
+// --update rewrites the .golden files instead of comparing. Review the diff before committing it:
+// any change to them is a change to what MDTextLabel and MD2BB show.
+//
+// Each document is also rendered with text coalescing and replayed from one recording into another.
+// Both must give the same stream byte for byte, so optimizations of the renderer can be checked
+// against the plain full parse. In the canonical form adjacent text is merged, as that is all
+// coalescing may change, and empty text is left out. Source ranges are not written out, but must
+// be the same in every variant.
+//
+// A few behaviours the corpus can't show run as checks of their own before it: block source ranges
+// at markup offsets, and link reference libraries.
+
+#include "md_recording_sink.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char* BLOCK_NAMES[] = { "doc", "quote", "ul", "ol", "li", "hr", "h", "code", "html", "p", "table",
+	"thead", "tbody", "tr", "th", "td" };
+
+/**
+ * Fixed style for the tests, using every header and cell option so their output is covered as well
+ */
+static MDRenderStyle _make_style() {
+	MDRenderStyle style;
+	for (int i = 0; i < 6; i++) {
+		MDHeaderStyle& header = style.headers[i];
+		header.font_size = 32.0f - 4.0f * i;
+		header.bold = i < 3;
+		header.italic = i == 3;
+		header.underlined = i == 4;
+		header.has_color = i == 0 || i == 5;
+		header.font_color = { 0.25f, 0.5f, 0.75f, 1.0f };
+	}
+	style.table_head.border_color = { 1.0f, 1.0f, 1.0f, 0.5f };
+	style.table_head.padding[0] = 4.0f;
+	style.table_head.padding[2] = 4.0f;
+	style.table_head.row_bg_odd = { 0.1f, 0.1f, 0.1f, 1.0f };
+	style.table_head.row_bg_even = { 0.1f, 0.1f, 0.1f, 1.0f };
+	style.table_body.row_bg_odd = { 0.2f, 0.2f, 0.2f, 1.0f };
+	style.table_body.row_bg_even = { 0.3f, 0.3f, 0.3f, 1.0f };
+	style.table_body.size_override = true;
+	style.table_body.min_size_override[0] = 16.0f;
+	style.table_body.max_size_override[0] = 256.0f;
+	return style;
+}
+
+static void _append_format(std::string& output, const char* format, ...) {
+	char line[256];
+	va_list args;
+	va_start(args, format);
+	int size = vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	output.append(line, (size_t)size < sizeof(line) ? (size_t)size : sizeof(line) - 1);
+}
+
+static void _append_quoted(std::string& output, const std::string& text) {
+	output += '"';
+	for (unsigned char c : text) {
+		switch (c) {
+			case '"':
+				output += "\\\"";
+				break;
+			case '\\':
+				output += "\\\\";
+				break;
+			case '\n':
+				output += "\\n";
+				break;
+			case '\t':
+				output += "\\t";
+				break;
+			default:
+				// UTF-8 is kept as is so the golden files stay readable
+				if (c < 0x20 || c == 0x7f)
+					_append_format(output, "\\x%02x", c);
+				else
+					output += (char)c;
+		}
+	}
+	output += '"';
+}
+
+static void _append_color(std::string& output, const MDColor& color) {
+	_append_format(output, " %g %g %g %g", color.r, color.g, color.b, color.a);
+}
+
+/**
+ * Write a recording as one line per call, indented by tag depth.
+ * Returns false, with the reason in r_error, if pushes and pops or blocks don't balance.
+ */
+static bool _write_canonical(const MDRecordingSink& recording, std::string& output, std::string& r_error) {
+	int depth = 0;
+	int blocks = 0;
+	std::string pending_text;
+
+	auto indent = [&]() { output.append((size_t)depth * 2, ' '); };
+	auto flush_text = [&]() {
+		if (pending_text.empty())
+			return;
+		indent();
+		output += "text ";
+		_append_quoted(output, pending_text);
+		output += '\n';
+		pending_text.clear();
+	};
+
+	for (const MDRenderCommand& command : recording.commands) {
+		if (command.op == MD_OP_TEXT) {
+			pending_text.append(recording.text.data() + command.a, command.b);
+			continue;
+		}
+		if (command.op == MD_OP_SOURCE)
+			continue;
+		flush_text();
+		if (command.op == MD_OP_POP) {
+			if (depth == 0) {
+				r_error = "pop without a matching push";
+				return false;
+			}
+			depth--;
+			indent();
+			output += "pop\n";
+			continue;
+		}
+		if (command.op == MD_OP_LEAVE_BLOCK) {
+			blocks--;
+		}
+		indent();
+		switch (command.op) {
+			case MD_OP_ENTER_BLOCK:
+			case MD_OP_LEAVE_BLOCK:
+				if (command.a >= sizeof(BLOCK_NAMES) / sizeof(BLOCK_NAMES[0])) {
+					r_error = "unknown block type";
+					return false;
+				}
+				_append_format(output, "%s %s\n", command.op == MD_OP_ENTER_BLOCK ? "enter" : "leave", BLOCK_NAMES[command.a]);
+				break;
+			case MD_OP_PUSH_FONT_SIZE:
+				{
+					float size;
+					memcpy(&size, &command.a, sizeof(size));
+					_append_format(output, "font_size %g\n", size);
+				}
+				break;
+			case MD_OP_PUSH_BOLD:
+				output += "bold\n";
+				break;
+			case MD_OP_PUSH_ITALICS:
+				output += "italics\n";
+				break;
+			case MD_OP_PUSH_UNDERLINE:
+				output += "underline\n";
+				break;
+			case MD_OP_PUSH_STRIKETHROUGH:
+				output += "strikethrough\n";
+				break;
+			case MD_OP_PUSH_MONO:
+				output += "mono\n";
+				break;
+			case MD_OP_PUSH_COLOR:
+				output += "color";
+				_append_color(output, recording.colors[command.a]);
+				output += '\n';
+				break;
+			case MD_OP_PUSH_PARAGRAPH:
+				output += "paragraph\n";
+				break;
+			case MD_OP_PUSH_LIST:
+				_append_format(output, "list %s '%c'\n", command.a != 0 ? "ordered" : "unordered", (char)command.b);
+				break;
+			case MD_OP_PUSH_TABLE:
+				_append_format(output, "table %u\n", command.a);
+				break;
+			case MD_OP_SET_CELL_STYLE:
+				{
+					const MDCellStyle& style = recording.cell_styles[command.a];
+					output += "cell_style border";
+					_append_color(output, style.border_color);
+					_append_format(output, " padding %g %g %g %g odd", style.padding[0], style.padding[1], style.padding[2], style.padding[3]);
+					_append_color(output, style.row_bg_odd);
+					output += " even";
+					_append_color(output, style.row_bg_even);
+					if (style.size_override)
+						_append_format(output, " size %g %g %g %g", style.min_size_override[0], style.min_size_override[1],
+								style.max_size_override[0], style.max_size_override[1]);
+					output += '\n';
+				}
+				break;
+			case MD_OP_PUSH_CELL:
+				output += "cell\n";
+				break;
+			case MD_OP_IMAGE:
+				output += "image ";
+				_append_quoted(output, std::string(recording.text.data() + command.a, command.b));
+				output += '\n';
+				break;
+			default:
+				break;
+		}
+		switch (command.op) {
+			case MD_OP_ENTER_BLOCK:
+				blocks++;
+				break;
+			case MD_OP_LEAVE_BLOCK:
+			case MD_OP_SET_CELL_STYLE:
+			case MD_OP_IMAGE:
+				break;
+			default:
+				depth++;
+		}
+		if (blocks < 0) {
+			r_error = "leave_block without a matching enter_block";
+			return false;
+		}
+	}
+	flush_text();
+	if (depth != 0 || blocks != 0) {
+		r_error = "unbalanced output at the end of the document";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Source ranges of a recording in order, offset and size packed into one value
+ */
+static void _get_source_ranges(const MDRecordingSink& recording, std::vector<uint64_t>& r_ranges) {
+	r_ranges.clear();
+	for (const MDRenderCommand& command : recording.commands) {
+		if (command.op == MD_OP_SOURCE)
+			r_ranges.push_back((uint64_t)command.a << 32 | command.b);
+	}
+}
+
+static bool _read_file(const std::string& path, std::string& r_data) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	r_data = buffer.str();
+	return true;
+}
+
+static bool _write_file(const std::string& path, const std::string& data) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file << data;
+	return file.good();
+}
+
+/**
+ * Render one document every supported way. Returns false and prints why if the variants disagree.
+ */
+static bool _render(const MDRenderStyle& style, const std::string& name, const std::string& source, std::string& r_canonical) {
+	std::string outputs[2];
+	std::vector<uint64_t> source_ranges[2];
+	for (int coalesce = 0; coalesce < 2; coalesce++) {
+		MDRecordingSink recording;
+		MDTypedRenderer<MDRecordingSink> renderer(style, recording);
+		renderer.set_coalesce_text(coalesce != 0);
+		if (renderer.render(source.data(), (MD_SIZE)source.size()) != MD_OK) {
+			fprintf(stderr, "FAIL %s: %s\n", name.c_str(), renderer.get_error() != nullptr ? renderer.get_error() : "render failed");
+			return false;
+		}
+		std::string error;
+		if (!_write_canonical(recording, outputs[coalesce], error)) {
+			fprintf(stderr, "FAIL %s%s: %s\n", name.c_str(), coalesce ? " (coalesced)" : "", error.c_str());
+			return false;
+		}
+		_get_source_ranges(recording, source_ranges[coalesce]);
+
+		if (!coalesce) {
+			// Replayed against the source, so source ranges are recorded again as well
+			MDRecordingSink replayed;
+			recording.replay(replayed, source.data());
+			std::string replayed_output;
+			std::vector<uint64_t> replayed_ranges;
+			_get_source_ranges(replayed, replayed_ranges);
+			if (!_write_canonical(replayed, replayed_output, error) || replayed_output != outputs[0] || replayed_ranges != source_ranges[0]) {
+				fprintf(stderr, "FAIL %s: replaying the recording changes the output\n", name.c_str());
+				return false;
+			}
+		}
+	}
+	if (outputs[1] != outputs[0] || source_ranges[1] != source_ranges[0]) {
+		fprintf(stderr, "FAIL %s: coalesced text differs from the full parse\n", name.c_str());
+		return false;
+	}
+	r_canonical = outputs[0];
+	return true;
+}
+
+// Index of the block containing offset, or -1
+static int _find_block(const std::vector<std::pair<int, int>>& blocks, int offset) {
+	for (size_t i = 0; i < blocks.size(); i++) {
+		if (offset >= blocks[i].first && offset < blocks[i].second)
+			return (int)i;
+	}
+	return -1;
+}
+
+/**
+ * Build block ranges the way MDTextLabel's anchor map does: the source ranges of each outermost block of
+ * MDTextLabel::_is_anchor_block, widened to whole lines. Then check that markup, which md4c reports no text
+ * for, is found in its block by get_block_at_offset().
+ */
+static bool _check_block_offsets(const MDRenderStyle& style) {
+	static const char DOCUMENT[] =
+			"# Heading\n"
+			"\n"
+			"- item one\n"
+			"- item **two**\n"
+			"\n"
+			"> quoted\n"
+			"\n"
+			"```gd\n"
+			"code\n"
+			"```\n"
+			"\n"
+			"Setext\n"
+			"======\n"
+			"\n"
+			"[ref]: /url\n"
+			"\n"
+			"**bold**\n";
+	// Last occurrence of the marker in the document, and the block it has to map to
+	static const struct {
+		const char* marker;
+		int block;
+	} MARKERS[] = {
+		{ "# Heading", 0 },
+		{ "- item one", 1 },
+		{ "- item **", 2 },
+		{ "**\n\n>", 2 },
+		{ "> quoted", 3 },
+		{ "```gd", 4 },
+		{ "```\n\nSetext", 4 },
+		{ "======", 5 },
+		{ "[ref]", -1 },
+		{ "**bold", 6 },
+		{ "**\n", 6 },
+	};
+
+	MDRecordingSink recording;
+	MDTypedRenderer<MDRecordingSink> renderer(style, recording);
+	std::string source = DOCUMENT;
+	if (renderer.render(source.data(), (MD_SIZE)source.size()) != MD_OK) {
+		fprintf(stderr, "FAIL block offsets: render failed\n");
+		return false;
+	}
+	std::vector<std::pair<int, int>> blocks;
+	int depth = 0;
+	for (const MDRenderCommand& command : recording.commands) {
+		bool anchor_block = false;
+		switch ((MD_BLOCKTYPE)command.a) {
+			case MD_BLOCK_LI:
+			case MD_BLOCK_H:
+			case MD_BLOCK_P:
+			case MD_BLOCK_CODE:
+			case MD_BLOCK_HTML:
+			case MD_BLOCK_TABLE:
+			case MD_BLOCK_HR:
+				anchor_block = true;
+				break;
+			default:
+				break;
+		}
+		if (command.op == MD_OP_ENTER_BLOCK && anchor_block && depth++ == 0) {
+			blocks.push_back({ -1, -1 });
+		} else if (command.op == MD_OP_LEAVE_BLOCK && anchor_block && --depth == 0 && blocks.back().first < 0) {
+			blocks.pop_back();
+		} else if (command.op == MD_OP_SOURCE && depth > 0) {
+			if (blocks.back().first < 0)
+				blocks.back().first = (int)command.a;
+			blocks.back().second = std::max(blocks.back().second, (int)(command.a + command.b));
+		}
+	}
+	for (size_t i = 0; i < blocks.size(); i++) {
+		int min_begin = i > 0 ? blocks[i - 1].second : 0;
+		int next_begin = i + 1 < blocks.size() ? blocks[i + 1].first : (int)source.size();
+		md_widen_source_range(source.data(), (MD_SIZE)source.size(), min_begin, next_begin, blocks[i].first, blocks[i].second);
+	}
+
+	bool passed = true;
+	for (const auto& marker : MARKERS) {
+		int offset = (int)source.rfind(marker.marker);
+		int block = _find_block(blocks, offset);
+		if (block != marker.block) {
+			fprintf(stderr, "FAIL block offsets: \"%s\" at %d is in block %d, expected %d\n", marker.marker, offset, block, marker.block);
+			passed = false;
+		}
+	}
+	return passed;
+}
+
+/**
+ * A document much shorter than the library definition it uses, as in a tooltip showing one glossary term,
+ * must still resolve it: link reference budgets are sized from the document, but not for library definitions.
+ */
+static bool _check_ref_library(const MDRenderStyle& style) {
+	static const char LIBRARY[] = "[hp]: https://wiki.example.com/stats/hit-points-and-health \"Hit points: how much damage you can take\"\n";
+	MD_REF_LIBRARY* library = md_ref_library_build(LIBRARY, (MD_SIZE)strlen(LIBRARY), MDRenderer::PARSER_FLAGS, nullptr);
+	if (library == nullptr) {
+		fprintf(stderr, "FAIL ref library: cannot build the library\n");
+		return false;
+	}
+	MDRecordingSink recording;
+	MDTypedRenderer<MDRecordingSink> renderer(style, recording);
+	renderer.set_ref_library(library);
+	std::string source = "[hp]";
+	int err = renderer.render(source.data(), (MD_SIZE)source.size());
+	md_ref_library_free(library);
+	std::string text(recording.text.begin(), recording.text.end());
+	if (err != MD_OK || text.find('[') != std::string::npos) {
+		fprintf(stderr, "FAIL ref library: \"%s\" is not resolved from the library, rendered as \"%s\"\n", source.c_str(), text.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Print the first line that differs, enough to find it in the golden file
+ */
+static void _print_first_difference(const std::string& expected, const std::string& actual) {
+	size_t line = 1;
+	size_t start = 0;
+	size_t size = std::min(expected.size(), actual.size());
+	size_t i = 0;
+	for (; i < size && expected[i] == actual[i]; i++) {
+		if (expected[i] == '\n') {
+			line++;
+			start = i + 1;
+		}
+	}
+	size_t expected_end = expected.find('\n', start);
+	size_t actual_end = actual.find('\n', start);
+	fprintf(stderr, "  line %zu\n  expected: %s\n  actual:   %s\n", line,
+			expected.substr(start, expected_end == std::string::npos ? std::string::npos : expected_end - start).c_str(),
+			actual.substr(start, actual_end == std::string::npos ? std::string::npos : actual_end - start).c_str());
+}
+
+static bool _list_corpus(const std::string& corpus_dir, std::vector<std::string>& r_names) {
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(corpus_dir, error)) {
+		if (entry.path().extension() == ".md")
+			r_names.push_back(entry.path().filename().string());
+	}
+	if (error)
+		return false;
+	std::sort(r_names.begin(), r_names.end());
+	return true;
+}
+
+int main(int argc, char** argv) {
+	std::string corpus_dir = "golden/corpus";
+	bool update = false;
+	std::vector<std::string> names;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--corpus" && i + 1 < argc) {
+			corpus_dir = argv[++i];
+		} else if (arg == "--update") {
+			update = true;
+		} else if (arg.size() > 3 && arg.compare(arg.size() - 3, 3, ".md") == 0) {
+			names.push_back(arg.substr(arg.find_last_of('/') + 1));
+		} else {
+			fprintf(stderr, "Usage: %s [--corpus DIR] [--update] [name.md ...]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (names.empty() && !_list_corpus(corpus_dir, names)) {
+		fprintf(stderr, "Cannot read %s\n", corpus_dir.c_str());
+		return 1;
+	}
+
+	MDRenderStyle style = _make_style();
+	int failed = 0;
+	int updated = 0;
+	if (!_check_block_offsets(style))
+		failed++;
+	if (!_check_ref_library(style))
+		failed++;
+	for (const std::string& name : names) {
+		std::string path = corpus_dir + "/" + name;
+		std::string golden_path = path.substr(0, path.size() - 3) + ".golden";
+		std::string source;
+		if (!_read_file(path, source)) {
+			fprintf(stderr, "FAIL %s: cannot read %s\n", name.c_str(), path.c_str());
+			failed++;
+			continue;
+		}
+		std::string actual;
+		if (!_render(style, name, source, actual)) {
+			failed++;
+			continue;
+		}
+
+		std::string expected;
+		bool has_golden = _read_file(golden_path, expected);
+		if (update) {
+			if (has_golden && expected == actual)
+				continue;
+			if (!_write_file(golden_path, actual)) {
+				fprintf(stderr, "FAIL %s: cannot write %s\n", name.c_str(), golden_path.c_str());
+				failed++;
+				continue;
+			}
+			printf("updated %s\n", golden_path.c_str());
+			updated++;
+		} else if (!has_golden) {
+			fprintf(stderr, "FAIL %s: no %s, run with --update to create it\n", name.c_str(), golden_path.c_str());
+			failed++;
+		} else if (expected != actual) {
+			fprintf(stderr, "FAIL %s: output differs from %s\n", name.c_str(), golden_path.c_str());
+			_print_first_difference(expected, actual);
+			failed++;
+		}
+	}
+
+	if (update)
+		printf("%zu documents, %d golden files updated, %d failed\n", names.size(), updated, failed);
+	else
+		printf("%zu documents, %d failed\n", names.size(), failed);
+	return failed == 0 ? 0 : 1;
+}
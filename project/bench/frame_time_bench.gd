@@ -0,0 +1,222 @@
+extends Control
+## Frame time benchmark for MDTextLabel workloads. Run headless from the repository root:
+##
+##     godot --headless --path project res://bench/frame_time_bench.tscn -- --out=report.json
+##
+## Scenarios:
+##  - large_document: set_markdown() of a large document, once per frame.
+##  - chat_append: append_markdown() of short chat lines, several per frame.
+##  - many_labels: a list of small labels, all set in the same frame.
+## For each, records p50/p95/p99 of the markdown call's wall time, of the frame time
+## (which includes RichTextLabel's layout), and the RichTextLabel item counts.
+## The report is JSON with a fixed layout, so runs of two builds can be diffed.
+
+const LARGE_DOCUMENT_SECTIONS := 120
+const LARGE_DOCUMENT_RUNS := 40
+const CHAT_LINES := 600
+const CHAT_LINES_PER_FRAME := 4
+const LIST_LABELS := 200
+const LIST_RUNS := 10
+# Frames after each step, so deferred layout work is included in the frame times
+const SETTLE_FRAMES := 2
+
+var _format := MD2BBFormat.new()
+var _frame_times_usec: Array[int] = []
+var _last_frame_usec := 0
+var _recording := false
+
+
+func _ready() -> void:
+	var out_path := "user://frame_time_bench.json"
+	for arg in OS.get_cmdline_user_args():
+		if arg.begins_with("--out="):
+			out_path = arg.trim_prefix("--out=")
+
+	var report := {
+		"benchmark": "frame_time_bench",
+		"engine": Engine.get_version_info()["string"],
+		"scenarios": [
+			await _bench_large_document(),
+			await _bench_chat_append(),
+			await _bench_many_labels(),
+		],
+	}
+
+	var json := JSON.stringify(report, "  ", false)
+	print(json)
+	var file := FileAccess.open(out_path, FileAccess.WRITE)
+	if file == null:
+		push_error("Cannot write report to %s" % out_path)
+		get_tree().quit(1)
+		return
+	file.store_string(json + "\n")
+	file.close()
+	get_tree().quit()
+
+
+func _process(_delta: float) -> void:
+	var now := Time.get_ticks_usec()
+	if _recording and _last_frame_usec > 0:
+		_frame_times_usec.append(now - _last_frame_usec)
+	_last_frame_usec = now
+
+
+func _bench_large_document() -> Dictionary:
+	var label := _make_label()
+	label.set_anchors_preset(Control.PRESET_FULL_RECT)
+	add_child(label)
+	var markdown := _make_document(LARGE_DOCUMENT_SECTIONS)
+	var call_times: Array[int] = []
+	var item_counts: Array[int] = []
+
+	await _begin_frames()
+	for run in LARGE_DOCUMENT_RUNS:
+		var start := Time.get_ticks_usec()
+		label.set_markdown(markdown)
+		call_times.append(Time.get_ticks_usec() - start)
+		item_counts.append(label.get_rendered_item_count())
+		await _settle()
+	var frame_times := _end_frames()
+
+	label.queue_free()
+	return _scenario("large_document", markdown.to_utf8_buffer().size(), call_times, frame_times, item_counts)
+
+
+func _bench_chat_append() -> Dictionary:
+	var label := _make_label()
+	label.set_anchors_preset(Control.PRESET_FULL_RECT)
+	label.scroll_following = true
+	add_child(label)
+	label.set_markdown("")
+	var call_times: Array[int] = []
+	var item_counts: Array[int] = []
+	var rng := RandomNumberGenerator.new()
+	rng.seed = 42
+
+	await _begin_frames()
+	for line in CHAT_LINES:
+		var start := Time.get_ticks_usec()
+		label.append_markdown(_make_chat_line(rng, line))
+		call_times.append(Time.get_ticks_usec() - start)
+		item_counts.append(label.get_rendered_item_count())
+		if line % CHAT_LINES_PER_FRAME == CHAT_LINES_PER_FRAME - 1:
+			await get_tree().process_frame
+	await _settle()
+	var frame_times := _end_frames()
+
+	var size := label.get_markdown().to_utf8_buffer().size()
+	label.queue_free()
+	return _scenario("chat_append", size, call_times, frame_times, item_counts)
+
+
+func _bench_many_labels() -> Dictionary:
+	var scroll := ScrollContainer.new()
+	scroll.set_anchors_preset(Control.PRESET_FULL_RECT)
+	var list := VBoxContainer.new()
+	list.size_flags_horizontal = Control.SIZE_EXPAND_FILL
+	scroll.add_child(list)
+	add_child(scroll)
+	var labels: Array[MDTextLabel] = []
+	for i in LIST_LABELS:
+		var label := _make_label()
+		label.fit_content = true
+		label.size_flags_horizontal = Control.SIZE_EXPAND_FILL
+		list.add_child(label)
+		labels.append(label)
+
+	var call_times: Array[int] = []
+	var item_counts: Array[int] = []
+	var bytes := 0
+	await _begin_frames()
+	for run in LIST_RUNS:
+		for i in labels.size():
+			var markdown := "### Item %d\n\nA *small* entry with `code`, a [link](#item-%d) and **bold** text. Run %d.\n" % [i, i, run]
+			bytes += markdown.to_utf8_buffer().size()
+			var start := Time.get_ticks_usec()
+			labels[i].set_markdown(markdown)
+			call_times.append(Time.get_ticks_usec() - start)
+			item_counts.append(labels[i].get_rendered_item_count())
+		await _settle()
+	var frame_times := _end_frames()
+
+	scroll.queue_free()
+	return _scenario("many_labels", bytes / LIST_RUNS, call_times, frame_times, item_counts)
+
+
+func _make_label() -> MDTextLabel:
+	var label := MDTextLabel.new()
+	label.format = _format
+	return label
+
+
+func _make_document(sections: int) -> String:
+	var parts: PackedStringArray = []
+	for i in sections:
+		parts.append("## Section %d\n" % i)
+		parts.append("Some *emphasized* and **strong** prose with `inline code`, an entity &mdash; and a [link](#section-%d).\n" % i)
+		parts.append("A second line of the same paragraph, escaped \\*stars\\* and ~~struck~~ words.\n")
+		parts.append("- first item\n- second item with _underline_\n  - nested item\n")
+		parts.append("> A quote with **bold** text.\n")
+		if i % 4 == 0:
+			parts.append("| Name | Value | Notes |\n|------|------:|-------|\n")
+			for row in 8:
+				parts.append("| row %d | %d | *note* `%d` |\n" % [row, row * i, row])
+		if i % 5 == 0:
+			parts.append("```\nfunc example_%d():\n\tpass\n```\n" % i)
+		parts.append("\n")
+	return "\n".join(parts)
+
+
+func _make_chat_line(rng: RandomNumberGenerator, index: int) -> String:
+	var words := ["gg", "**nice**", "*wow*", "`/help`", "that was close", "[wiki](https://example.com)", "lol", "~~oops~~", "&lt;3"]
+	var text := "**Player%d**:" % rng.randi_range(1, 16)
+	for i in rng.randi_range(2, 10):
+		text += " " + words[rng.randi_range(0, words.size() - 1)]
+	return text + " (%d)\n\n" % index
+
+
+func _begin_frames() -> void:
+	await get_tree().process_frame
+	_frame_times_usec.clear()
+	_last_frame_usec = 0
+	_recording = true
+
+
+func _end_frames() -> Array[int]:
+	_recording = false
+	return _frame_times_usec.duplicate()
+
+
+func _settle() -> void:
+	for i in SETTLE_FRAMES:
+		await get_tree().process_frame
+
+
+func _scenario(name: String, bytes: int, call_times: Array[int], frame_times: Array[int], item_counts: Array[int]) -> Dictionary:
+	return {
+		"name": name,
+		"bytes": bytes,
+		"calls": call_times.size(),
+		"call_usec": _percentiles(call_times),
+		"frames": frame_times.size(),
+		"frame_usec": _percentiles(frame_times),
+		"items": _percentiles(item_counts),
+	}
+
+
+func _percentiles(values: Array[int]) -> Dictionary:
+	if values.is_empty():
+		return { "p50": 0, "p95": 0, "p99": 0, "max": 0 }
+	var sorted := values.duplicate()
+	sorted.sort()
+	return {
+		"p50": _percentile(sorted, 0.50),
+		"p95": _percentile(sorted, 0.95),
+		"p99": _percentile(sorted, 0.99),
+		"max": sorted[sorted.size() - 1],
+	}
+
+
+func _percentile(sorted: Array[int], fraction: float) -> int:
+	var index := clampi(ceili(fraction * sorted.size()) - 1, 0, sorted.size() - 1)
+	return sorted[index]
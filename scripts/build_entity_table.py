@@ -0,0 +1,128 @@
+#!/usr/bin/env python
+"""
+Generates src/gen/md_entity.gen.h, a minimal perfect hash of every HTML5 named
+character reference, from the WHATWG list bundled with Python (html.entities).
+
+Names are hashed without the '&' and ';' md4c reports around them. A first hash
+picks a bucket, and each bucket stores the seed that sends all of its names to
+free slots of the entry table:
+
+    entry = MD_ENTITIES[md_entity_hash(MD_ENTITY_SEEDS[md_entity_hash(0, name) % MD_ENTITY_BUCKETS], name) % MD_ENTITY_COUNT]
+
+A lookup is two hashes of the name and one comparison against the entry's name.
+
+Usage: build_entity_table.py <output.gen.h>
+"""
+
+import html.entities
+import sys
+
+# Average names per bucket. Higher makes the seed table smaller but the search slower
+BUCKET_LOAD = 2
+MAX_SEED = 0xFFFF
+
+
+def _hash(seed, name):
+    """32-bit FNV-1a, seeded by folding the seed into the offset basis."""
+    h = (2166136261 ^ seed) & 0xFFFFFFFF
+    for byte in name:
+        h ^= byte
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def _entities():
+    """Returns [(name bytes, (codepoint, ...))] for every entity md4c can report, i.e. with a ';'."""
+    entities = []
+    for name, value in sorted(html.entities.html5.items()):
+        if name.endswith(";"):
+            entities.append((name[:-1].encode("ascii"), tuple(ord(c) for c in value)))
+    return entities
+
+
+def _build_hash(names):
+    """Returns (seeds per bucket, slot per name index)."""
+    count = len(names)
+    bucket_count = (count + BUCKET_LOAD - 1) // BUCKET_LOAD
+    buckets = [[] for _ in range(bucket_count)]
+    for index, name in enumerate(names):
+        buckets[_hash(0, name) % bucket_count].append(index)
+
+    seeds = [0] * bucket_count
+    slots = [None] * count
+    taken = [False] * count
+    # Place the largest buckets first, while most slots are still free
+    for bucket in sorted(range(bucket_count), key=lambda b: -len(buckets[b])):
+        members = buckets[bucket]
+        if not members:
+            continue
+        for seed in range(MAX_SEED + 1):
+            candidate = [_hash(seed, names[index]) % count for index in members]
+            if len(set(candidate)) == len(candidate) and not any(taken[slot] for slot in candidate):
+                break
+        else:
+            raise ValueError("No perfect hash seed found for bucket %d" % bucket)
+        seeds[bucket] = seed
+        for index, slot in zip(members, candidate):
+            slots[index] = slot
+            taken[slot] = True
+    return seeds, slots
+
+
+def _format_array(values, per_line=24):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("\t" + ", ".join(str(v) for v in values[i : i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+def generate(output_path):
+    entities = _entities()
+    names = [name for name, _ in entities]
+    seeds, slots = _build_hash(names)
+
+    table = [None] * len(entities)
+    for (name, codepoints), slot in zip(entities, slots):
+        table[slot] = (name, codepoints)
+
+    name_data = b"".join(name for name, _ in table)
+    if len(name_data) > 0xFFFF or max(len(name) for name in names) > 0xFF:
+        raise ValueError("Entity names don't fit the offset and size types")
+    if any(len(cps) > 2 or (len(cps) == 2 and cps[1] > 0xFFFF) for _, cps in table):
+        raise ValueError("Entity expands to more than the supported code points")
+
+    entry_lines = []
+    offset = 0
+    for name, codepoints in table:
+        second = codepoints[1] if len(codepoints) > 1 else 0
+        entry_lines.append("\t{ %d, %d, 0x%x, 0x%x }, // %s" % (offset, len(name), codepoints[0], second, name.decode("ascii")))
+        offset += len(name)
+
+    name_lines = []
+    for i in range(0, len(name_data), 96):
+        name_lines.append('\t"%s"' % name_data[i : i + 96].decode("ascii"))
+
+    with open(output_path, "w", encoding="utf-8", newline="\n") as f:
+        f.write("// THIS FILE IS GENERATED by scripts/build_entity_table.py. DO NOT EDIT.\n")
+        f.write("// %d HTML5 named character references, %d buckets.\n\n" % (len(table), len(seeds)))
+        f.write("#define MD_ENTITY_COUNT %d\n" % len(table))
+        f.write("#define MD_ENTITY_BUCKETS %d\n" % len(seeds))
+        f.write("#define MD_ENTITY_MAX_NAME %d\n\n" % max(len(name) for name in names))
+        f.write("struct MDEntityEntry {\n")
+        f.write("\tuint16_t name_offset;\n")
+        f.write("\tuint8_t name_size;\n")
+        f.write("\tuint32_t codepoint;\n")
+        f.write("\t// 0 unless the entity expands to two code points\n")
+        f.write("\tuint16_t second_codepoint;\n")
+        f.write("};\n\n")
+        f.write("static const uint16_t MD_ENTITY_SEEDS[] = {\n%s\n};\n\n" % _format_array(seeds))
+        f.write("static const MDEntityEntry MD_ENTITIES[] = {\n%s\n};\n\n" % "\n".join(entry_lines))
+        f.write("// All names back to back, in entry order\n")
+        f.write("static const char MD_ENTITY_NAMES[] =\n%s;\n" % "\n".join(name_lines))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print(__doc__.strip(), file=sys.stderr)
+        sys.exit(1)
+    generate(sys.argv[1])
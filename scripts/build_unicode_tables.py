@@ -0,0 +1,163 @@
+#!/usr/bin/env python
+"""
+Generates src/gen/md4c_unicode.gen.h from the range maps in src/md4c_unicode_maps.h.
+
+Every codepoint is mapped to a record holding its whitespace/punctuation flags
+and its case folding, through a two-stage table:
+
+    record = RECORDS[STAGE2[(STAGE1[cp >> SHIFT] << SHIFT) | (cp & MASK)]]
+
+Identical stage 2 blocks are shared, and 1:1 foldings are stored as a delta so
+whole alphabets share a single record.
+
+Usage: build_unicode_tables.py <md4c_unicode_maps.h> <output.gen.h>
+"""
+
+import re
+import sys
+
+MAX_CODEPOINT = 0x10FFFF
+
+FLAG_WHITESPACE = 0x1
+FLAG_PUNCT = 0x2
+
+
+def _parse_maps(text):
+    """Returns {array name: [int, ...]} with R()/S() expanded to md4c's encoding."""
+    maps = {}
+    for match in re.finditer(r"static const unsigned (\w+)\[\] = \{(.*?)\};", text, re.S):
+        values = []
+        body = re.sub(r"/\*.*?\*/", "", match.group(2), flags=re.S)
+        for item in re.finditer(r"R\((\w+),\s*(\w+)\)|S\((\w+)\)|(0x[0-9a-fA-F]+)", body):
+            if item.group(1):
+                values.append(int(item.group(1), 16) | 0x40000000)
+                values.append(int(item.group(2), 16) | 0x80000000)
+            else:
+                values.append(int(item.group(3) or item.group(4), 16))
+        maps[match.group(1)] = values
+    return maps
+
+
+def _entries(range_map):
+    """Yields (index, first, last) for every single codepoint or range in the map."""
+    i = 0
+    while i < len(range_map):
+        if range_map[i] & 0x40000000:
+            yield i, range_map[i] & 0xFFFFFF, range_map[i + 1] & 0xFFFFFF
+            i += 2
+        else:
+            yield i, range_map[i], range_map[i]
+            i += 1
+
+
+def _build_records(maps):
+    """Returns a list with a (flags, n_codepoints, c0, c1, c2) tuple per codepoint."""
+    flags = bytearray(MAX_CODEPOINT + 1)
+    for name, flag in (("WHITESPACE_MAP", FLAG_WHITESPACE), ("PUNCT_MAP", FLAG_PUNCT)):
+        for _, first, last in _entries(maps[name]):
+            for cp in range(first, last + 1):
+                flags[cp] |= flag
+
+    # Same lookup order and range semantics as md4c's original md_get_unicode_fold_info().
+    folds = {}
+    for n in (3, 2, 1):
+        range_map = maps["FOLD_MAP_%d" % n]
+        data = maps["FOLD_MAP_%d_DATA" % n]
+        for index, first, last in _entries(range_map):
+            codepoints = data[index * n : index * n + n]
+            for cp in range(first, last + 1):
+                folded = list(codepoints)
+                if cp != first:
+                    if first + 1 == codepoints[0]:
+                        folded[0] = cp + (1 if (cp & 1) == (first & 1) else 0)
+                    else:
+                        folded[0] += cp - first
+                folds[cp] = folded
+
+    records = []
+    for cp in range(MAX_CODEPOINT + 1):
+        folded = folds.get(cp)
+        if folded is None or len(folded) == 1:
+            delta = (folded[0] - cp) if folded else 0
+            records.append((flags[cp], 1, delta, 0, 0))
+        else:
+            records.append((flags[cp], len(folded)) + tuple(folded + [0] * (3 - len(folded))))
+    return records
+
+
+def _ctype(max_value):
+    return "uint8_t" if max_value <= 0xFF else "uint16_t"
+
+
+def _build_tables(records):
+    unique = [(0, 1, 0, 0, 0)]
+    record_index = {unique[0]: 0}
+    indices = []
+    for record in records:
+        if record not in record_index:
+            record_index[record] = len(unique)
+            unique.append(record)
+        indices.append(record_index[record])
+
+    best = None
+    for shift in range(4, 11):
+        block_size = 1 << shift
+        blocks = {}
+        stage1 = []
+        stage2 = []
+        for start in range(0, len(indices), block_size):
+            block = tuple(indices[start : start + block_size])
+            if block not in blocks:
+                blocks[block] = len(blocks)
+                stage2.extend(block)
+            stage1.append(blocks[block])
+        size = len(stage1) * (1 if len(blocks) <= 0x100 else 2) + len(stage2) * (1 if len(unique) <= 0x100 else 2)
+        if best is None or size < best[0]:
+            best = (size, shift, stage1, stage2)
+    return unique, best
+
+
+def _format_array(values, per_line=24):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("    " + ", ".join(str(v) for v in values[i : i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+def generate(maps_path, output_path):
+    with open(maps_path, "r", encoding="utf-8") as f:
+        maps = _parse_maps(f.read())
+
+    records, (size, shift, stage1, stage2) = _build_tables(_build_records(maps))
+    if len(records) > 0xFFFF:
+        raise ValueError("Too many distinct Unicode records: %d" % len(records))
+
+    record_lines = []
+    for flags, n, c0, c1, c2 in records:
+        record_lines.append("    { %d, %d, { %d, 0x%04x, 0x%04x } }," % (flags, n, c0, c1, c2) if n == 1
+                            else "    { %d, %d, { 0x%04x, 0x%04x, 0x%04x } }," % (flags, n, c0, c1, c2))
+
+    with open(output_path, "w", encoding="utf-8", newline="\n") as f:
+        f.write("/* THIS FILE IS GENERATED by scripts/build_unicode_tables.py from src/md4c_unicode_maps.h. DO NOT EDIT. */\n")
+        f.write("/* %d records, %d stage 1 and %d stage 2 entries, %d bytes of index. */\n\n" % (len(records), len(stage1), len(stage2), size))
+        f.write("#define MD_UNICODE_SHIFT            %d\n" % shift)
+        f.write("#define MD_UNICODE_MASK             0x%x\n" % ((1 << shift) - 1))
+        f.write("#define MD_UNICODE_FLAG_WHITESPACE  0x%x\n" % FLAG_WHITESPACE)
+        f.write("#define MD_UNICODE_FLAG_PUNCT       0x%x\n\n" % FLAG_PUNCT)
+        f.write("typedef struct MD_UNICODE_RECORD_tag MD_UNICODE_RECORD;\n")
+        f.write("struct MD_UNICODE_RECORD_tag {\n")
+        f.write("    unsigned char flags;\n")
+        f.write("    unsigned char n_codepoints;\n")
+        f.write("    /* With n_codepoints == 1, codepoints[0] is the offset to add to the codepoint. */\n")
+        f.write("    int codepoints[3];\n")
+        f.write("};\n\n")
+        f.write("static const MD_UNICODE_RECORD MD_UNICODE_RECORDS[] = {\n%s\n};\n\n" % "\n".join(record_lines))
+        f.write("static const %s MD_UNICODE_STAGE1[] = {\n%s\n};\n\n" % (_ctype(max(stage1)), _format_array(stage1)))
+        f.write("static const %s MD_UNICODE_STAGE2[] = {\n%s\n};\n" % (_ctype(max(stage2)), _format_array(stage2)))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        print(__doc__.strip(), file=sys.stderr)
+        sys.exit(1)
+    generate(sys.argv[1], sys.argv[2])
@@ -0,0 +1,110 @@
+#include "md2bb.h"
+
+#include "md_bbcode_sink.h"
+#include "md_plain_text.h"
+#include "md_source_buffer.h"
+
+#include <godot_cpp/core/class_db.hpp>
+
+using namespace godot;
+
+void MD2BB::_bind_methods() {
+	ClassDB::bind_static_method("MD2BB", D_METHOD("convert", "markdown", "format", "library"), &MD2BB::convert, DEFVAL(Ref<MD2BBFormat>()), DEFVAL(Ref<MDRefLibrary>()));
+	ClassDB::bind_static_method("MD2BB", D_METHOD("to_plain_text", "markdown", "library"), &MD2BB::to_plain_text, DEFVAL(Ref<MDRefLibrary>()));
+	ClassDB::bind_static_method("MD2BB", D_METHOD("get_parse_stats", "markdown", "format", "library"), &MD2BB::get_parse_stats, DEFVAL(Ref<MD2BBFormat>()), DEFVAL(Ref<MDRefLibrary>()));
+	ClassDB::bind_static_method("MD2BB", D_METHOD("convert_file", "path", "format", "library"), &MD2BB::convert_file, DEFVAL(Ref<MD2BBFormat>()), DEFVAL(Ref<MDRefLibrary>()));
+	ClassDB::bind_static_method("MD2BB", D_METHOD("to_plain_text_file", "path", "library"), &MD2BB::to_plain_text_file, DEFVAL(Ref<MDRefLibrary>()));
+}
+
+// Renders exactly like convert(), so get_parse_stats() measures what convert() costs
+static int _render_bbcode(const MD_CHAR* text, MD_SIZE size, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library, MDBBCodeSink& sink, MDDocumentStats& r_stats) {
+	MDRenderStyle style;
+	if (format.is_valid())
+		format->get_render_style(style);
+
+	// BBCode is usually a little longer than the markdown it came from, so this avoids most regrowth
+	sink.output.reserve(size + size / 2 + 64);
+	MDTypedRenderer<MDBBCodeSink> renderer(style, sink, &MD_GODOT_ALLOCATOR);
+	if (library.is_valid())
+		renderer.set_ref_library(library->get_library());
+	int err = renderer.render(text, size);
+	if (err != MD_OK && renderer.get_error() != nullptr) {
+		ERR_PRINT(String("[MD2BB] ") + renderer.get_error());
+	}
+	r_stats = renderer.get_stats();
+	return err;
+}
+
+static int _render_plain_text(const MD_CHAR* text, MD_SIZE size, const Ref<MDRefLibrary>& library, MDStringBuilder& output) {
+	MDPlainTextRenderer renderer(output, &MD_GODOT_ALLOCATOR);
+	if (library.is_valid())
+		renderer.set_ref_library(library->get_library());
+	return renderer.render(text, size);
+}
+
+/**
+ * Convert markdown to a BBCode string. A null format renders headers and tables unstyled.
+ * Reference links the document doesn't define are looked up in the optional library.
+ */
+String MD2BB::convert(const String& markdown, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library) {
+	CharString md_utf8 = markdown.utf8();
+	MDBBCodeSink sink(&MD_GODOT_ALLOCATOR);
+	MDDocumentStats stats;
+	int err = _render_bbcode(md_utf8.get_data(), md_utf8.length(), format, library, sink, stats);
+	ERR_FAIL_COND_V_MSG(err != MD_OK, String(), "Failed to convert markdown, error code " + String::num_int64(err));
+	return String::utf8(sink.output.get_data(), sink.output.size());
+}
+
+/**
+ * Convert a UTF-8 markdown file like convert(). The file is read once and parsed straight from its bytes, so a large
+ * document is never held as a String.
+ */
+String MD2BB::convert_file(const String& path, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library) {
+	MDSourceBuffer source;
+	Error error = source.load_file(path);
+	ERR_FAIL_COND_V_MSG(error != OK, String(), "Cannot load markdown file " + path);
+	MDBBCodeSink sink(&MD_GODOT_ALLOCATOR);
+	MDDocumentStats stats;
+	int err = _render_bbcode(source.get_data(), source.size(), format, library, sink, stats);
+	ERR_FAIL_COND_V_MSG(err != MD_OK, String(), "Failed to convert markdown, error code " + String::num_int64(err));
+	return String::utf8(sink.output.get_data(), sink.output.size());
+}
+
+/**
+ * Convert markdown like convert(), but return what it produced and cost instead of the BBCode, for checking content
+ * against a budget before it ships. Same keys as MDTextLabel.get_parse_stats(), except items, plus error:
+ * the render's error code, 0 if it succeeded. The other values only cover the part rendered before an error.
+ */
+Dictionary MD2BB::get_parse_stats(const String& markdown, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library) {
+	CharString md_utf8 = markdown.utf8();
+	MDBBCodeSink sink(&MD_GODOT_ALLOCATOR);
+	MDDocumentStats stats;
+	int err = _render_bbcode(md_utf8.get_data(), md_utf8.length(), format, library, sink, stats);
+	Dictionary result = md_stats_to_dictionary(stats);
+	result["error"] = err;
+	return result;
+}
+
+/**
+ * Extract the readable text of markdown without any styling, and with entities decoded
+ */
+String MD2BB::to_plain_text(const String& markdown, const Ref<MDRefLibrary>& library) {
+	CharString md_utf8 = markdown.utf8();
+	MDStringBuilder output(&MD_GODOT_ALLOCATOR);
+	int err = _render_plain_text(md_utf8.get_data(), md_utf8.length(), library, output);
+	ERR_FAIL_COND_V_MSG(err != MD_OK, String(), "Failed to extract plain text, error code " + String::num_int64(err));
+	return String::utf8(output.get_data(), output.size());
+}
+
+/**
+ * Extract the readable text of a UTF-8 markdown file like to_plain_text(), without decoding the file into a String first
+ */
+String MD2BB::to_plain_text_file(const String& path, const Ref<MDRefLibrary>& library) {
+	MDSourceBuffer source;
+	Error error = source.load_file(path);
+	ERR_FAIL_COND_V_MSG(error != OK, String(), "Cannot load markdown file " + path);
+	MDStringBuilder output(&MD_GODOT_ALLOCATOR);
+	int err = _render_plain_text(source.get_data(), source.size(), library, output);
+	ERR_FAIL_COND_V_MSG(err != MD_OK, String(), "Failed to extract plain text, error code " + String::num_int64(err));
+	return String::utf8(output.get_data(), output.size());
+}
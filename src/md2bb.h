@@ -0,0 +1,31 @@
+#ifndef MD2BB_H
+#define MD2BB_H
+
+#include "md_text_label.h"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+
+namespace godot {
+
+/**
+ * Headless Markdown to BBCode conversion, for consumers that aren't a MDTextLabel (Label3D, tooltips, logs).
+ * Uses the same renderer as MDTextLabel. Static and re-entrant, so it can be called from any thread.
+ * Also extracts plain text for text-to-speech, accessibility and length budgets.
+ */
+class MD2BB : public RefCounted {
+	GDCLASS(MD2BB, RefCounted)
+
+protected:
+	static void _bind_methods();
+
+public:
+	static String convert(const String& markdown, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library);
+	static String to_plain_text(const String& markdown, const Ref<MDRefLibrary>& library);
+	static String convert_file(const String& path, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library);
+	static String to_plain_text_file(const String& path, const Ref<MDRefLibrary>& library);
+	static Dictionary get_parse_stats(const String& markdown, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library);
+};
+
+}
+
+#endif
@@ -24,6 +24,8 @@
  */
 
 #include "md4c.h"
+#include "md4c_dialects.h"
+#include "md_trace.h"
 
 #include <limits.h>
 #include <stdint.h>
@@ -118,6 +120,15 @@
 /* Suppress "unused parameter" warnings. */
 #define MD_UNUSED(x)                ((void)x)
 
+/* Dialect flags of the parse. When this file is compiled for a single
+ * dialect (see md4c_dialects.h), they are a constant so the compiler can drop
+ * all code of the disabled features. */
+#ifdef MD4C_FIXED_FLAGS
+    #define MD_FLAGS(ctx)           ((unsigned) (MD4C_FIXED_FLAGS))
+#else
+    #define MD_FLAGS(ctx)           ((ctx)->parser.flags)
+#endif
+
 
 /******************************
  ***  Some internal limits  ***
@@ -162,6 +173,29 @@ struct MD_MARKSTACK_tag {
     int top;        /* -1 if empty. */
 };
 
+/* Bump-pointer arena. Chunks are kept in a list which is reused after a reset,
+ * so resetting is O(1) and a warm arena does not allocate at all. */
+typedef struct MD_ARENA_CHUNK_tag MD_ARENA_CHUNK;
+struct MD_ARENA_CHUNK_tag {
+    MD_ARENA_CHUNK* next;
+    size_t size;            /* Usable bytes following this header. */
+};
+
+typedef struct MD_ARENA_tag MD_ARENA;
+struct MD_ARENA_tag {
+    MD_ARENA_CHUNK* first;
+    MD_ARENA_CHUNK* current;
+    size_t used;            /* Bytes used in the current chunk. */
+    void* last;             /* The most recent allocation, which may grow in place. */
+};
+
+/* Position in an arena, to free everything allocated after it at once. */
+typedef struct MD_ARENA_MARK_tag MD_ARENA_MARK;
+struct MD_ARENA_MARK_tag {
+    MD_ARENA_CHUNK* current;
+    size_t used;
+};
+
 /* Context propagated through all the parsing. */
 typedef struct MD_CTX_tag MD_CTX;
 struct MD_CTX_tag {
@@ -185,6 +219,10 @@ struct MD_CTX_tag {
     void** ref_def_hashtable;
     int ref_def_hashtable_size;
     SZ max_ref_def_output;
+    SZ max_ref_library_output;  /* Same for MD_PARSER::ref_library, which is budgeted apart. */
+    /* See MD_PARSE_STATS. */
+    unsigned ref_library_lookups;
+    unsigned ref_library_hits;
 
     /* Stack of inline/span markers.
      * This is only used for parsing a single block contents but by storing it
@@ -193,6 +231,8 @@ struct MD_CTX_tag {
     MD_MARK* marks;
     int n_marks;
     int alloc_marks;
+    /* Set when md_add_mark() refused to go over MD_PARSER::max_marks. */
+    int limit_exceeded;
 
 #if defined MD4C_USE_UTF16
     char mark_char_map[128];
@@ -219,10 +259,12 @@ struct MD_CTX_tag {
 #define BRACKET_OPENERS                 (ctx->opener_stacks[14])
 #define DOLLAR_OPENERS                  (ctx->opener_stacks[15])
 
-    /* Stack of dummies which need to call free() for pointers stored in them.
-     * These are constructed during inline parsing and freed after all the block
-     * is processed (i.e. all callbacks referring those strings are called). */
-    MD_MARKSTACK ptr_stack;
+    /* Arenas for small allocations which are never freed one by one.
+     * doc_arena lives for the whole md_parse() (reference definitions), while
+     * block_arena is recycled after each leaf block (attribute builds, link
+     * titles and labels merged from multiple lines). */
+    MD_ARENA doc_arena;
+    MD_ARENA block_arena;
 
     /* For resolving table rows. */
     int n_table_cell_boundaries;
@@ -266,6 +308,140 @@ struct MD_CTX_tag {
     int last_list_item_starts_with_two_blank_lines;
 };
 
+/* Memory management. Everything goes through MD_PARSER::allocator when the
+ * application provides one, so it can account or pool the memory. */
+static void*
+md_malloc(MD_CTX* ctx, size_t size)
+{
+    if(ctx->parser.allocator != NULL)
+        return ctx->parser.allocator->malloc_fn(size, ctx->parser.allocator->userdata);
+    return malloc(size);
+}
+
+static void*
+md_realloc(MD_CTX* ctx, void* ptr, size_t size)
+{
+    if(ctx->parser.allocator != NULL)
+        return ctx->parser.allocator->realloc_fn(ptr, size, ctx->parser.allocator->userdata);
+    return realloc(ptr, size);
+}
+
+static void
+md_free(MD_CTX* ctx, void* ptr)
+{
+    if(ptr == NULL)
+        return;
+    if(ctx->parser.allocator != NULL)
+        ctx->parser.allocator->free_fn(ptr, ctx->parser.allocator->userdata);
+    else
+        free(ptr);
+}
+
+#define MD_ARENA_CHUNK_SIZE     4096
+#define MD_ARENA_ALIGN          sizeof(void*)
+#define MD_ARENA_ALIGN_SIZE(sz) (((sz) + MD_ARENA_ALIGN - 1) & ~(MD_ARENA_ALIGN - 1))
+#define MD_ARENA_CHUNK_DATA(c)  ((char*) ((c) + 1))
+
+static void*
+md_arena_alloc(MD_CTX* ctx, MD_ARENA* arena, size_t size)
+{
+    MD_ARENA_CHUNK* chunk = arena->current;
+    void* ptr;
+
+    size = MD_ARENA_ALIGN_SIZE(size > 0 ? size : 1);
+    while(chunk == NULL  ||  arena->used + size > chunk->size) {
+        MD_ARENA_CHUNK* next = (chunk != NULL ? chunk->next : arena->first);
+
+        if(next == NULL  ||  size > next->size) {
+            /* Link a new chunk right after the current one. */
+            size_t chunk_size = MAX(size, (size_t) MD_ARENA_CHUNK_SIZE);
+            MD_ARENA_CHUNK* new_chunk;
+
+            new_chunk = (MD_ARENA_CHUNK*) md_malloc(ctx, sizeof(MD_ARENA_CHUNK) + chunk_size);
+            if(new_chunk == NULL) {
+                MD_LOG("malloc() failed.");
+                return NULL;
+            }
+            new_chunk->size = chunk_size;
+            new_chunk->next = next;
+            if(chunk != NULL)
+                chunk->next = new_chunk;
+            else
+                arena->first = new_chunk;
+            next = new_chunk;
+        }
+
+        chunk = next;
+        arena->current = chunk;
+        arena->used = 0;
+    }
+
+    ptr = MD_ARENA_CHUNK_DATA(chunk) + arena->used;
+    arena->used += size;
+    arena->last = ptr;
+    return ptr;
+}
+
+static void*
+md_arena_realloc(MD_CTX* ctx, MD_ARENA* arena, void* ptr, size_t old_size, size_t new_size)
+{
+    void* new_ptr;
+
+    /* The last allocation can often just be extended. */
+    if(ptr != NULL  &&  ptr == arena->last) {
+        size_t offset = (size_t) ((char*) ptr - MD_ARENA_CHUNK_DATA(arena->current));
+        if(offset + MD_ARENA_ALIGN_SIZE(new_size) <= arena->current->size) {
+            arena->used = offset + MD_ARENA_ALIGN_SIZE(new_size);
+            return ptr;
+        }
+    }
+
+    new_ptr = md_arena_alloc(ctx, arena, new_size);
+    if(new_ptr != NULL  &&  ptr != NULL)
+        memcpy(new_ptr, ptr, MIN(old_size, new_size));
+    return new_ptr;
+}
+
+static MD_ARENA_MARK
+md_arena_mark(MD_ARENA* arena)
+{
+    MD_ARENA_MARK mark;
+    mark.current = arena->current;
+    mark.used = arena->used;
+    /* Allocations made before the mark must not grow past it. */
+    arena->last = NULL;
+    return mark;
+}
+
+static void
+md_arena_rewind(MD_ARENA* arena, MD_ARENA_MARK mark)
+{
+    arena->current = mark.current;
+    arena->used = mark.used;
+    arena->last = NULL;
+}
+
+static void
+md_arena_reset(MD_ARENA* arena)
+{
+    arena->current = arena->first;
+    arena->used = 0;
+    arena->last = NULL;
+}
+
+static void
+md_arena_fini(MD_CTX* ctx, MD_ARENA* arena)
+{
+    MD_ARENA_CHUNK* chunk = arena->first;
+
+    while(chunk != NULL) {
+        MD_ARENA_CHUNK* next = chunk->next;
+        md_free(ctx, chunk);
+        chunk = next;
+    }
+    memset(arena, 0, sizeof(MD_ARENA));
+}
+
 enum MD_LINETYPE_tag {
     MD_LINE_BLANK,
     MD_LINE_HR,
@@ -419,6 +595,16 @@ md_text_with_null_replacement(MD_CTX* ctx, MD_TEXTTYPE type, const CHAR* str, SZ
             goto abort;                                                     \
     } while(0)
 
+/* Like MD_CHECK(), also tracing the call as the phase 'name' (see md_trace.h). */
+#define MD_TRACE_CHECK(name, func)                                          \
+    do {                                                                    \
+        MD_TRACE_BEGIN(name);                                               \
+        ret = (func);                                                       \
+        MD_TRACE_END();                                                     \
+        if(ret < 0)                                                         \
+            goto abort;                                                     \
+    } while(0)
+
 
 #define MD_TEMP_BUFFER(sz)                                                  \
     do {                                                                    \
@@ -426,7 +612,7 @@ md_text_with_null_replacement(MD_CTX* ctx, MD_TEXTTYPE type, const CHAR* str, SZ
             CHAR* new_buffer;                                               \
             SZ new_size = ((sz) + (sz) / 2 + 128) & ~127;                   \
                                                                             \
-            new_buffer = realloc(ctx->buffer, new_size);                    \
+            new_buffer = md_realloc(ctx, ctx->buffer, new_size);                    \
             if(new_buffer == NULL) {                                        \
                 MD_LOG("realloc() failed.");                                \
                 ret = -1;                                                   \
@@ -545,242 +731,48 @@ struct MD_UNICODE_FOLD_INFO_tag {
 
 
 #if defined MD4C_USE_UTF16 || defined MD4C_USE_UTF8
-    /* Binary search over sorted "map" of codepoints. Consecutive sequences
-     * of codepoints may be encoded in the map by just using the
-     * (MIN_CODEPOINT | 0x40000000) and (MAX_CODEPOINT | 0x80000000).
-     *
-     * Returns index of the found record in the map (in the case of ranges,
-     * the minimal value is used); or -1 on failure. */
-    static int
-    md_unicode_bsearch__(unsigned codepoint, const unsigned* map, size_t map_size)
-    {
-        int beg, end;
-        int pivot_beg, pivot_end;
-
-        beg = 0;
-        end = (int) map_size-1;
-        while(beg <= end) {
-            /* Pivot may be a range, not just a single value. */
-            pivot_beg = pivot_end = (beg + end) / 2;
-            if(map[pivot_end] & 0x40000000)
-                pivot_end++;
-            if(map[pivot_beg] & 0x80000000)
-                pivot_beg--;
-
-            if(codepoint < (map[pivot_beg] & 0x00ffffff))
-                end = pivot_beg - 1;
-            else if(codepoint > (map[pivot_end] & 0x00ffffff))
-                beg = pivot_end + 1;
-            else
-                return pivot_beg;
-        }
+    /* Two-stage lookup tables generated at build time from md4c_unicode_maps.h
+     * (see scripts/build_unicode_tables.py), so every classification is
+     * a couple of array loads instead of a binary search. */
+    #include "gen/md4c_unicode.gen.h"
 
-        return -1;
+    static inline const MD_UNICODE_RECORD*
+    md_unicode_record__(unsigned codepoint)
+    {
+        if(codepoint > 0x10ffff)
+            return &MD_UNICODE_RECORDS[0];
+        return &MD_UNICODE_RECORDS[MD_UNICODE_STAGE2[
+                    ((unsigned) MD_UNICODE_STAGE1[codepoint >> MD_UNICODE_SHIFT] << MD_UNICODE_SHIFT) |
+                    (codepoint & MD_UNICODE_MASK)]];
     }
 
     static int
     md_is_unicode_whitespace__(unsigned codepoint)
     {
-#define R(cp_min, cp_max)   ((cp_min) | 0x40000000), ((cp_max) | 0x80000000)
-#define S(cp)               (cp)
-        /* Unicode "Zs" category.
-         * (generated by scripts/build_whitespace_map.py) */
-        static const unsigned WHITESPACE_MAP[] = {
-            S(0x0020), S(0x00a0), S(0x1680), R(0x2000,0x200a), S(0x202f), S(0x205f), S(0x3000)
-        };
-#undef R
-#undef S
-
         /* The ASCII ones are the most frequently used ones, also CommonMark
          * specification requests few more in this range. */
         if(codepoint <= 0x7f)
             return ISWHITESPACE_(codepoint);
 
-        return (md_unicode_bsearch__(codepoint, WHITESPACE_MAP, SIZEOF_ARRAY(WHITESPACE_MAP)) >= 0);
+        return (md_unicode_record__(codepoint)->flags & MD_UNICODE_FLAG_WHITESPACE);
     }
 
     static int
     md_is_unicode_punct__(unsigned codepoint)
     {
-#define R(cp_min, cp_max)   ((cp_min) | 0x40000000), ((cp_max) | 0x80000000)
-#define S(cp)               (cp)
-        /* Unicode general "P" and "S" categories.
-         * (generated by scripts/build_punct_map.py) */
-        static const unsigned PUNCT_MAP[] = {
-            R(0x0021,0x002f), R(0x003a,0x0040), R(0x005b,0x0060), R(0x007b,0x007e), R(0x00a1,0x00a9),
-            R(0x00ab,0x00ac), R(0x00ae,0x00b1), S(0x00b4), R(0x00b6,0x00b8), S(0x00bb), S(0x00bf), S(0x00d7),
-            S(0x00f7), R(0x02c2,0x02c5), R(0x02d2,0x02df), R(0x02e5,0x02eb), S(0x02ed), R(0x02ef,0x02ff), S(0x0375),
-            S(0x037e), R(0x0384,0x0385), S(0x0387), S(0x03f6), S(0x0482), R(0x055a,0x055f), R(0x0589,0x058a),
-            R(0x058d,0x058f), S(0x05be), S(0x05c0), S(0x05c3), S(0x05c6), R(0x05f3,0x05f4), R(0x0606,0x060f),
-            S(0x061b), R(0x061d,0x061f), R(0x066a,0x066d), S(0x06d4), S(0x06de), S(0x06e9), R(0x06fd,0x06fe),
-            R(0x0700,0x070d), R(0x07f6,0x07f9), R(0x07fe,0x07ff), R(0x0830,0x083e), S(0x085e), S(0x0888),
-            R(0x0964,0x0965), S(0x0970), R(0x09f2,0x09f3), R(0x09fa,0x09fb), S(0x09fd), S(0x0a76), R(0x0af0,0x0af1),
-            S(0x0b70), R(0x0bf3,0x0bfa), S(0x0c77), S(0x0c7f), S(0x0c84), S(0x0d4f), S(0x0d79), S(0x0df4), S(0x0e3f),
-            S(0x0e4f), R(0x0e5a,0x0e5b), R(0x0f01,0x0f17), R(0x0f1a,0x0f1f), S(0x0f34), S(0x0f36), S(0x0f38),
-            R(0x0f3a,0x0f3d), S(0x0f85), R(0x0fbe,0x0fc5), R(0x0fc7,0x0fcc), R(0x0fce,0x0fda), R(0x104a,0x104f),
-            R(0x109e,0x109f), S(0x10fb), R(0x1360,0x1368), R(0x1390,0x1399), S(0x1400), R(0x166d,0x166e),
-            R(0x169b,0x169c), R(0x16eb,0x16ed), R(0x1735,0x1736), R(0x17d4,0x17d6), R(0x17d8,0x17db),
-            R(0x1800,0x180a), S(0x1940), R(0x1944,0x1945), R(0x19de,0x19ff), R(0x1a1e,0x1a1f), R(0x1aa0,0x1aa6),
-            R(0x1aa8,0x1aad), R(0x1b5a,0x1b6a), R(0x1b74,0x1b7e), R(0x1bfc,0x1bff), R(0x1c3b,0x1c3f),
-            R(0x1c7e,0x1c7f), R(0x1cc0,0x1cc7), S(0x1cd3), S(0x1fbd), R(0x1fbf,0x1fc1), R(0x1fcd,0x1fcf),
-            R(0x1fdd,0x1fdf), R(0x1fed,0x1fef), R(0x1ffd,0x1ffe), R(0x2010,0x2027), R(0x2030,0x205e),
-            R(0x207a,0x207e), R(0x208a,0x208e), R(0x20a0,0x20c0), R(0x2100,0x2101), R(0x2103,0x2106),
-            R(0x2108,0x2109), S(0x2114), R(0x2116,0x2118), R(0x211e,0x2123), S(0x2125), S(0x2127), S(0x2129),
-            S(0x212e), R(0x213a,0x213b), R(0x2140,0x2144), R(0x214a,0x214d), S(0x214f), R(0x218a,0x218b),
-            R(0x2190,0x2426), R(0x2440,0x244a), R(0x249c,0x24e9), R(0x2500,0x2775), R(0x2794,0x2b73),
-            R(0x2b76,0x2b95), R(0x2b97,0x2bff), R(0x2ce5,0x2cea), R(0x2cf9,0x2cfc), R(0x2cfe,0x2cff), S(0x2d70),
-            R(0x2e00,0x2e2e), R(0x2e30,0x2e5d), R(0x2e80,0x2e99), R(0x2e9b,0x2ef3), R(0x2f00,0x2fd5),
-            R(0x2ff0,0x2fff), R(0x3001,0x3004), R(0x3008,0x3020), S(0x3030), R(0x3036,0x3037), R(0x303d,0x303f),
-            R(0x309b,0x309c), S(0x30a0), S(0x30fb), R(0x3190,0x3191), R(0x3196,0x319f), R(0x31c0,0x31e3), S(0x31ef),
-            R(0x3200,0x321e), R(0x322a,0x3247), S(0x3250), R(0x3260,0x327f), R(0x328a,0x32b0), R(0x32c0,0x33ff),
-            R(0x4dc0,0x4dff), R(0xa490,0xa4c6), R(0xa4fe,0xa4ff), R(0xa60d,0xa60f), S(0xa673), S(0xa67e),
-            R(0xa6f2,0xa6f7), R(0xa700,0xa716), R(0xa720,0xa721), R(0xa789,0xa78a), R(0xa828,0xa82b),
-            R(0xa836,0xa839), R(0xa874,0xa877), R(0xa8ce,0xa8cf), R(0xa8f8,0xa8fa), S(0xa8fc), R(0xa92e,0xa92f),
-            S(0xa95f), R(0xa9c1,0xa9cd), R(0xa9de,0xa9df), R(0xaa5c,0xaa5f), R(0xaa77,0xaa79), R(0xaade,0xaadf),
-            R(0xaaf0,0xaaf1), S(0xab5b), R(0xab6a,0xab6b), S(0xabeb), S(0xfb29), R(0xfbb2,0xfbc2), R(0xfd3e,0xfd4f),
-            S(0xfdcf), R(0xfdfc,0xfdff), R(0xfe10,0xfe19), R(0xfe30,0xfe52), R(0xfe54,0xfe66), R(0xfe68,0xfe6b),
-            R(0xff01,0xff0f), R(0xff1a,0xff20), R(0xff3b,0xff40), R(0xff5b,0xff65), R(0xffe0,0xffe6),
-            R(0xffe8,0xffee), R(0xfffc,0xfffd), R(0x10100,0x10102), R(0x10137,0x1013f), R(0x10179,0x10189),
-            R(0x1018c,0x1018e), R(0x10190,0x1019c), S(0x101a0), R(0x101d0,0x101fc), S(0x1039f), S(0x103d0),
-            S(0x1056f), S(0x10857), R(0x10877,0x10878), S(0x1091f), S(0x1093f), R(0x10a50,0x10a58), S(0x10a7f),
-            S(0x10ac8), R(0x10af0,0x10af6), R(0x10b39,0x10b3f), R(0x10b99,0x10b9c), S(0x10ead), R(0x10f55,0x10f59),
-            R(0x10f86,0x10f89), R(0x11047,0x1104d), R(0x110bb,0x110bc), R(0x110be,0x110c1), R(0x11140,0x11143),
-            R(0x11174,0x11175), R(0x111c5,0x111c8), S(0x111cd), S(0x111db), R(0x111dd,0x111df), R(0x11238,0x1123d),
-            S(0x112a9), R(0x1144b,0x1144f), R(0x1145a,0x1145b), S(0x1145d), S(0x114c6), R(0x115c1,0x115d7),
-            R(0x11641,0x11643), R(0x11660,0x1166c), S(0x116b9), R(0x1173c,0x1173f), S(0x1183b), R(0x11944,0x11946),
-            S(0x119e2), R(0x11a3f,0x11a46), R(0x11a9a,0x11a9c), R(0x11a9e,0x11aa2), R(0x11b00,0x11b09),
-            R(0x11c41,0x11c45), R(0x11c70,0x11c71), R(0x11ef7,0x11ef8), R(0x11f43,0x11f4f), R(0x11fd5,0x11ff1),
-            S(0x11fff), R(0x12470,0x12474), R(0x12ff1,0x12ff2), R(0x16a6e,0x16a6f), S(0x16af5), R(0x16b37,0x16b3f),
-            R(0x16b44,0x16b45), R(0x16e97,0x16e9a), S(0x16fe2), S(0x1bc9c), S(0x1bc9f), R(0x1cf50,0x1cfc3),
-            R(0x1d000,0x1d0f5), R(0x1d100,0x1d126), R(0x1d129,0x1d164), R(0x1d16a,0x1d16c), R(0x1d183,0x1d184),
-            R(0x1d18c,0x1d1a9), R(0x1d1ae,0x1d1ea), R(0x1d200,0x1d241), S(0x1d245), R(0x1d300,0x1d356), S(0x1d6c1),
-            S(0x1d6db), S(0x1d6fb), S(0x1d715), S(0x1d735), S(0x1d74f), S(0x1d76f), S(0x1d789), S(0x1d7a9),
-            S(0x1d7c3), R(0x1d800,0x1d9ff), R(0x1da37,0x1da3a), R(0x1da6d,0x1da74), R(0x1da76,0x1da83),
-            R(0x1da85,0x1da8b), S(0x1e14f), S(0x1e2ff), R(0x1e95e,0x1e95f), S(0x1ecac), S(0x1ecb0), S(0x1ed2e),
-            R(0x1eef0,0x1eef1), R(0x1f000,0x1f02b), R(0x1f030,0x1f093), R(0x1f0a0,0x1f0ae), R(0x1f0b1,0x1f0bf),
-            R(0x1f0c1,0x1f0cf), R(0x1f0d1,0x1f0f5), R(0x1f10d,0x1f1ad), R(0x1f1e6,0x1f202), R(0x1f210,0x1f23b),
-            R(0x1f240,0x1f248), R(0x1f250,0x1f251), R(0x1f260,0x1f265), R(0x1f300,0x1f6d7), R(0x1f6dc,0x1f6ec),
-            R(0x1f6f0,0x1f6fc), R(0x1f700,0x1f776), R(0x1f77b,0x1f7d9), R(0x1f7e0,0x1f7eb), S(0x1f7f0),
-            R(0x1f800,0x1f80b), R(0x1f810,0x1f847), R(0x1f850,0x1f859), R(0x1f860,0x1f887), R(0x1f890,0x1f8ad),
-            R(0x1f8b0,0x1f8b1), R(0x1f900,0x1fa53), R(0x1fa60,0x1fa6d), R(0x1fa70,0x1fa7c), R(0x1fa80,0x1fa88),
-            R(0x1fa90,0x1fabd), R(0x1fabf,0x1fac5), R(0x1face,0x1fadb), R(0x1fae0,0x1fae8), R(0x1faf0,0x1faf8),
-            R(0x1fb00,0x1fb92), R(0x1fb94,0x1fbca)
-        };
-#undef R
-#undef S
-
         /* The ASCII ones are the most frequently used ones, also CommonMark
          * specification requests few more in this range. */
         if(codepoint <= 0x7f)
             return ISPUNCT_(codepoint);
 
-        return (md_unicode_bsearch__(codepoint, PUNCT_MAP, SIZEOF_ARRAY(PUNCT_MAP)) >= 0);
+        return (md_unicode_record__(codepoint)->flags & MD_UNICODE_FLAG_PUNCT);
     }
 
     static void
     md_get_unicode_fold_info(unsigned codepoint, MD_UNICODE_FOLD_INFO* info)
     {
-#define R(cp_min, cp_max)   ((cp_min) | 0x40000000), ((cp_max) | 0x80000000)
-#define S(cp)               (cp)
-        /* Unicode "Pc", "Pd", "Pe", "Pf", "Pi", "Po", "Ps" categories.
-         * (generated by scripts/build_folding_map.py) */
-        static const unsigned FOLD_MAP_1[] = {
-            R(0x0041,0x005a), S(0x00b5), R(0x00c0,0x00d6), R(0x00d8,0x00de), R(0x0100,0x012e), R(0x0132,0x0136),
-            R(0x0139,0x0147), R(0x014a,0x0176), S(0x0178), R(0x0179,0x017d), S(0x017f), S(0x0181), S(0x0182),
-            S(0x0184), S(0x0186), S(0x0187), S(0x0189), S(0x018a), S(0x018b), S(0x018e), S(0x018f), S(0x0190),
-            S(0x0191), S(0x0193), S(0x0194), S(0x0196), S(0x0197), S(0x0198), S(0x019c), S(0x019d), S(0x019f),
-            R(0x01a0,0x01a4), S(0x01a6), S(0x01a7), S(0x01a9), S(0x01ac), S(0x01ae), S(0x01af), S(0x01b1), S(0x01b2),
-            S(0x01b3), S(0x01b5), S(0x01b7), S(0x01b8), S(0x01bc), S(0x01c4), S(0x01c5), S(0x01c7), S(0x01c8),
-            S(0x01ca), R(0x01cb,0x01db), R(0x01de,0x01ee), S(0x01f1), S(0x01f2), S(0x01f4), S(0x01f6), S(0x01f7),
-            R(0x01f8,0x021e), S(0x0220), R(0x0222,0x0232), S(0x023a), S(0x023b), S(0x023d), S(0x023e), S(0x0241),
-            S(0x0243), S(0x0244), S(0x0245), R(0x0246,0x024e), S(0x0345), S(0x0370), S(0x0372), S(0x0376), S(0x037f),
-            S(0x0386), R(0x0388,0x038a), S(0x038c), S(0x038e), S(0x038f), R(0x0391,0x03a1), R(0x03a3,0x03ab),
-            S(0x03c2), S(0x03cf), S(0x03d0), S(0x03d1), S(0x03d5), S(0x03d6), R(0x03d8,0x03ee), S(0x03f0), S(0x03f1),
-            S(0x03f4), S(0x03f5), S(0x03f7), S(0x03f9), S(0x03fa), R(0x03fd,0x03ff), R(0x0400,0x040f),
-            R(0x0410,0x042f), R(0x0460,0x0480), R(0x048a,0x04be), S(0x04c0), R(0x04c1,0x04cd), R(0x04d0,0x052e),
-            R(0x0531,0x0556), R(0x10a0,0x10c5), S(0x10c7), S(0x10cd), R(0x13f8,0x13fd), S(0x1c80), S(0x1c81),
-            S(0x1c82), S(0x1c83), S(0x1c84), S(0x1c85), S(0x1c86), S(0x1c87), S(0x1c88), R(0x1c90,0x1cba),
-            R(0x1cbd,0x1cbf), R(0x1e00,0x1e94), S(0x1e9b), R(0x1ea0,0x1efe), R(0x1f08,0x1f0f), R(0x1f18,0x1f1d),
-            R(0x1f28,0x1f2f), R(0x1f38,0x1f3f), R(0x1f48,0x1f4d), S(0x1f59), S(0x1f5b), S(0x1f5d), S(0x1f5f),
-            R(0x1f68,0x1f6f), S(0x1fb8), S(0x1fb9), S(0x1fba), S(0x1fbb), S(0x1fbe), R(0x1fc8,0x1fcb), S(0x1fd8),
-            S(0x1fd9), S(0x1fda), S(0x1fdb), S(0x1fe8), S(0x1fe9), S(0x1fea), S(0x1feb), S(0x1fec), S(0x1ff8),
-            S(0x1ff9), S(0x1ffa), S(0x1ffb), S(0x2126), S(0x212a), S(0x212b), S(0x2132), R(0x2160,0x216f), S(0x2183),
-            R(0x24b6,0x24cf), R(0x2c00,0x2c2f), S(0x2c60), S(0x2c62), S(0x2c63), S(0x2c64), R(0x2c67,0x2c6b),
-            S(0x2c6d), S(0x2c6e), S(0x2c6f), S(0x2c70), S(0x2c72), S(0x2c75), S(0x2c7e), S(0x2c7f), R(0x2c80,0x2ce2),
-            S(0x2ceb), S(0x2ced), S(0x2cf2), R(0xa640,0xa66c), R(0xa680,0xa69a), R(0xa722,0xa72e), R(0xa732,0xa76e),
-            S(0xa779), S(0xa77b), S(0xa77d), R(0xa77e,0xa786), S(0xa78b), S(0xa78d), S(0xa790), S(0xa792),
-            R(0xa796,0xa7a8), S(0xa7aa), S(0xa7ab), S(0xa7ac), S(0xa7ad), S(0xa7ae), S(0xa7b0), S(0xa7b1), S(0xa7b2),
-            S(0xa7b3), R(0xa7b4,0xa7c2), S(0xa7c4), S(0xa7c5), S(0xa7c6), S(0xa7c7), S(0xa7c9), S(0xa7d0), S(0xa7d6),
-            S(0xa7d8), S(0xa7f5), R(0xab70,0xabbf), R(0xff21,0xff3a), R(0x10400,0x10427), R(0x104b0,0x104d3),
-            R(0x10570,0x1057a), R(0x1057c,0x1058a), R(0x1058c,0x10592), S(0x10594), S(0x10595), R(0x10c80,0x10cb2),
-            R(0x118a0,0x118bf), R(0x16e40,0x16e5f), R(0x1e900,0x1e921)
-        };
-        static const unsigned FOLD_MAP_1_DATA[] = {
-            0x0061, 0x007a, 0x03bc, 0x00e0, 0x00f6, 0x00f8, 0x00fe, 0x0101, 0x012f, 0x0133, 0x0137, 0x013a, 0x0148,
-            0x014b, 0x0177, 0x00ff, 0x017a, 0x017e, 0x0073, 0x0253, 0x0183, 0x0185, 0x0254, 0x0188, 0x0256, 0x0257,
-            0x018c, 0x01dd, 0x0259, 0x025b, 0x0192, 0x0260, 0x0263, 0x0269, 0x0268, 0x0199, 0x026f, 0x0272, 0x0275,
-            0x01a1, 0x01a5, 0x0280, 0x01a8, 0x0283, 0x01ad, 0x0288, 0x01b0, 0x028a, 0x028b, 0x01b4, 0x01b6, 0x0292,
-            0x01b9, 0x01bd, 0x01c6, 0x01c6, 0x01c9, 0x01c9, 0x01cc, 0x01cc, 0x01dc, 0x01df, 0x01ef, 0x01f3, 0x01f3,
-            0x01f5, 0x0195, 0x01bf, 0x01f9, 0x021f, 0x019e, 0x0223, 0x0233, 0x2c65, 0x023c, 0x019a, 0x2c66, 0x0242,
-            0x0180, 0x0289, 0x028c, 0x0247, 0x024f, 0x03b9, 0x0371, 0x0373, 0x0377, 0x03f3, 0x03ac, 0x03ad, 0x03af,
-            0x03cc, 0x03cd, 0x03ce, 0x03b1, 0x03c1, 0x03c3, 0x03cb, 0x03c3, 0x03d7, 0x03b2, 0x03b8, 0x03c6, 0x03c0,
-            0x03d9, 0x03ef, 0x03ba, 0x03c1, 0x03b8, 0x03b5, 0x03f8, 0x03f2, 0x03fb, 0x037b, 0x037d, 0x0450, 0x045f,
-            0x0430, 0x044f, 0x0461, 0x0481, 0x048b, 0x04bf, 0x04cf, 0x04c2, 0x04ce, 0x04d1, 0x052f, 0x0561, 0x0586,
-            0x2d00, 0x2d25, 0x2d27, 0x2d2d, 0x13f0, 0x13f5, 0x0432, 0x0434, 0x043e, 0x0441, 0x0442, 0x0442, 0x044a,
-            0x0463, 0xa64b, 0x10d0, 0x10fa, 0x10fd, 0x10ff, 0x1e01, 0x1e95, 0x1e61, 0x1ea1, 0x1eff, 0x1f00, 0x1f07,
-            0x1f10, 0x1f15, 0x1f20, 0x1f27, 0x1f30, 0x1f37, 0x1f40, 0x1f45, 0x1f51, 0x1f53, 0x1f55, 0x1f57, 0x1f60,
-            0x1f67, 0x1fb0, 0x1fb1, 0x1f70, 0x1f71, 0x03b9, 0x1f72, 0x1f75, 0x1fd0, 0x1fd1, 0x1f76, 0x1f77, 0x1fe0,
-            0x1fe1, 0x1f7a, 0x1f7b, 0x1fe5, 0x1f78, 0x1f79, 0x1f7c, 0x1f7d, 0x03c9, 0x006b, 0x00e5, 0x214e, 0x2170,
-            0x217f, 0x2184, 0x24d0, 0x24e9, 0x2c30, 0x2c5f, 0x2c61, 0x026b, 0x1d7d, 0x027d, 0x2c68, 0x2c6c, 0x0251,
-            0x0271, 0x0250, 0x0252, 0x2c73, 0x2c76, 0x023f, 0x0240, 0x2c81, 0x2ce3, 0x2cec, 0x2cee, 0x2cf3, 0xa641,
-            0xa66d, 0xa681, 0xa69b, 0xa723, 0xa72f, 0xa733, 0xa76f, 0xa77a, 0xa77c, 0x1d79, 0xa77f, 0xa787, 0xa78c,
-            0x0265, 0xa791, 0xa793, 0xa797, 0xa7a9, 0x0266, 0x025c, 0x0261, 0x026c, 0x026a, 0x029e, 0x0287, 0x029d,
-            0xab53, 0xa7b5, 0xa7c3, 0xa794, 0x0282, 0x1d8e, 0xa7c8, 0xa7ca, 0xa7d1, 0xa7d7, 0xa7d9, 0xa7f6, 0x13a0,
-            0x13ef, 0xff41, 0xff5a, 0x10428, 0x1044f, 0x104d8, 0x104fb, 0x10597, 0x105a1, 0x105a3, 0x105b1, 0x105b3,
-            0x105b9, 0x105bb, 0x105bc, 0x10cc0, 0x10cf2, 0x118c0, 0x118df, 0x16e60, 0x16e7f, 0x1e922, 0x1e943
-        };
-        static const unsigned FOLD_MAP_2[] = {
-            S(0x00df), S(0x0130), S(0x0149), S(0x01f0), S(0x0587), S(0x1e96), S(0x1e97), S(0x1e98), S(0x1e99),
-            S(0x1e9a), S(0x1e9e), S(0x1f50), R(0x1f80,0x1f87), R(0x1f88,0x1f8f), R(0x1f90,0x1f97), R(0x1f98,0x1f9f),
-            R(0x1fa0,0x1fa7), R(0x1fa8,0x1faf), S(0x1fb2), S(0x1fb3), S(0x1fb4), S(0x1fb6), S(0x1fbc), S(0x1fc2),
-            S(0x1fc3), S(0x1fc4), S(0x1fc6), S(0x1fcc), S(0x1fd6), S(0x1fe4), S(0x1fe6), S(0x1ff2), S(0x1ff3),
-            S(0x1ff4), S(0x1ff6), S(0x1ffc), S(0xfb00), S(0xfb01), S(0xfb02), S(0xfb05), S(0xfb06), S(0xfb13),
-            S(0xfb14), S(0xfb15), S(0xfb16), S(0xfb17)
-        };
-        static const unsigned FOLD_MAP_2_DATA[] = {
-            0x0073,0x0073, 0x0069,0x0307, 0x02bc,0x006e, 0x006a,0x030c, 0x0565,0x0582, 0x0068,0x0331, 0x0074,0x0308,
-            0x0077,0x030a, 0x0079,0x030a, 0x0061,0x02be, 0x0073,0x0073, 0x03c5,0x0313, 0x1f00,0x03b9, 0x1f07,0x03b9,
-            0x1f00,0x03b9, 0x1f07,0x03b9, 0x1f20,0x03b9, 0x1f27,0x03b9, 0x1f20,0x03b9, 0x1f27,0x03b9, 0x1f60,0x03b9,
-            0x1f67,0x03b9, 0x1f60,0x03b9, 0x1f67,0x03b9, 0x1f70,0x03b9, 0x03b1,0x03b9, 0x03ac,0x03b9, 0x03b1,0x0342,
-            0x03b1,0x03b9, 0x1f74,0x03b9, 0x03b7,0x03b9, 0x03ae,0x03b9, 0x03b7,0x0342, 0x03b7,0x03b9, 0x03b9,0x0342,
-            0x03c1,0x0313, 0x03c5,0x0342, 0x1f7c,0x03b9, 0x03c9,0x03b9, 0x03ce,0x03b9, 0x03c9,0x0342, 0x03c9,0x03b9,
-            0x0066,0x0066, 0x0066,0x0069, 0x0066,0x006c, 0x0073,0x0074, 0x0073,0x0074, 0x0574,0x0576, 0x0574,0x0565,
-            0x0574,0x056b, 0x057e,0x0576, 0x0574,0x056d
-        };
-        static const unsigned FOLD_MAP_3[] = {
-            S(0x0390), S(0x03b0), S(0x1f52), S(0x1f54), S(0x1f56), S(0x1fb7), S(0x1fc7), S(0x1fd2), S(0x1fd3),
-            S(0x1fd7), S(0x1fe2), S(0x1fe3), S(0x1fe7), S(0x1ff7), S(0xfb03), S(0xfb04)
-        };
-        static const unsigned FOLD_MAP_3_DATA[] = {
-            0x03b9,0x0308,0x0301, 0x03c5,0x0308,0x0301, 0x03c5,0x0313,0x0300, 0x03c5,0x0313,0x0301,
-            0x03c5,0x0313,0x0342, 0x03b1,0x0342,0x03b9, 0x03b7,0x0342,0x03b9, 0x03b9,0x0308,0x0300,
-            0x03b9,0x0308,0x0301, 0x03b9,0x0308,0x0342, 0x03c5,0x0308,0x0300, 0x03c5,0x0308,0x0301,
-            0x03c5,0x0308,0x0342, 0x03c9,0x0342,0x03b9, 0x0066,0x0066,0x0069, 0x0066,0x0066,0x006c
-        };
-#undef R
-#undef S
-        static const struct {
-            const unsigned* map;
-            const unsigned* data;
-            size_t map_size;
-            unsigned n_codepoints;
-        } FOLD_MAP_LIST[] = {
-            { FOLD_MAP_1, FOLD_MAP_1_DATA, SIZEOF_ARRAY(FOLD_MAP_1), 1 },
-            { FOLD_MAP_2, FOLD_MAP_2_DATA, SIZEOF_ARRAY(FOLD_MAP_2), 2 },
-            { FOLD_MAP_3, FOLD_MAP_3_DATA, SIZEOF_ARRAY(FOLD_MAP_3), 3 }
-        };
-
-        int i;
+        const MD_UNICODE_RECORD* record;
+        unsigned i;
 
         /* Fast path for ASCII characters. */
         if(codepoint <= 0x7f) {
@@ -791,39 +783,16 @@ struct MD_UNICODE_FOLD_INFO_tag {
             return;
         }
 
-        /* Try to locate the codepoint in any of the maps. */
-        for(i = 0; i < (int) SIZEOF_ARRAY(FOLD_MAP_LIST); i++) {
-            int index;
-
-            index = md_unicode_bsearch__(codepoint, FOLD_MAP_LIST[i].map, FOLD_MAP_LIST[i].map_size);
-            if(index >= 0) {
-                /* Found the mapping. */
-                unsigned n_codepoints = FOLD_MAP_LIST[i].n_codepoints;
-                const unsigned* map = FOLD_MAP_LIST[i].map;
-                const unsigned* codepoints = FOLD_MAP_LIST[i].data + (index * n_codepoints);
-
-                memcpy(info->codepoints, codepoints, sizeof(unsigned) * n_codepoints);
-                info->n_codepoints = n_codepoints;
-
-                if(FOLD_MAP_LIST[i].map[index] != codepoint) {
-                    /* The found mapping maps whole range of codepoints,
-                     * i.e. we have to offset info->codepoints[0] accordingly. */
-                    if((map[index] & 0x00ffffff)+1 == codepoints[0]) {
-                        /* Alternating type of the range. */
-                        info->codepoints[0] = codepoint + ((codepoint & 0x1) == (map[index] & 0x1) ? 1 : 0);
-                    } else {
-                        /* Range to range kind of mapping. */
-                        info->codepoints[0] += (codepoint - (map[index] & 0x00ffffff));
-                    }
-                }
-
-                return;
-            }
+        record = md_unicode_record__(codepoint);
+        info->n_codepoints = record->n_codepoints;
+        if(record->n_codepoints == 1) {
+            /* Simple mappings are stored as an offset, so whole alphabets
+             * share one record. Unmapped codepoints have an offset of 0. */
+            info->codepoints[0] = (unsigned) ((int) codepoint + record->codepoints[0]);
+            return;
         }
-
-        /* No mapping found. Map the codepoint to itself. */
-        info->codepoints[0] = codepoint;
-        info->n_codepoints = 1;
+        for(i = 0; i < record->n_codepoints; i++)
+            info->codepoints[i] = (unsigned) record->codepoints[i];
     }
 #endif
 
@@ -1024,15 +993,16 @@ md_merge_lines(MD_CTX* ctx, OFF beg, OFF end, const MD_LINE* lines, MD_SIZE n_li
     }
 }
 
-/* Wrapper of md_merge_lines() which allocates new buffer for the output string.
+/* Wrapper of md_merge_lines() which allocates new buffer for the output string
+ * from the given arena.
  */
 static int
-md_merge_lines_alloc(MD_CTX* ctx, OFF beg, OFF end, const MD_LINE* lines, MD_SIZE n_lines,
+md_merge_lines_alloc(MD_CTX* ctx, MD_ARENA* arena, OFF beg, OFF end, const MD_LINE* lines, MD_SIZE n_lines,
                     CHAR line_break_replacement_char, CHAR** p_str, SZ* p_size)
 {
     CHAR* buffer;
 
-    buffer = (CHAR*) malloc(sizeof(CHAR) * (end - beg));
+    buffer = (CHAR*) md_arena_alloc(ctx, arena, sizeof(CHAR) * (end - beg));
     if(buffer == NULL) {
         MD_LOG("malloc() failed.");
         return -1;
@@ -1045,21 +1015,6 @@ md_merge_lines_alloc(MD_CTX* ctx, OFF beg, OFF end, const MD_LINE* lines, MD_SIZ
     return 0;
 }
 
-static OFF
-md_skip_unicode_whitespace(const CHAR* label, OFF off, SZ size)
-{
-    SZ char_size;
-    unsigned codepoint;
-
-    while(off < size) {
-        codepoint = md_decode_unicode(label, off, size, &char_size);
-        if(!ISUNICODEWHITESPACE_(codepoint)  &&  !ISNEWLINE_(label[off]))
-            break;
-        off += char_size;
-    }
-
-    return off;
-}
 
 
 /******************************
@@ -1428,29 +1383,31 @@ md_build_attr_append_substr(MD_CTX* ctx, MD_ATTRIBUTE_BUILD* build,
                             MD_TEXTTYPE type, OFF off)
 {
     if(build->substr_count >= build->substr_alloc) {
-        MD_TEXTTYPE* new_substr_types;
-        OFF* new_substr_offsets;
+        char* new_substrs;
+        int old_alloc = build->substr_alloc;
 
+        /* Both arrays share one arena block, offsets first and types after
+         * them, so the block stays the arena's last allocation and usually
+         * grows in place. Note +1 to reserve space for final offset
+         * (== raw_size). */
         build->substr_alloc = (build->substr_alloc > 0
                 ? build->substr_alloc + build->substr_alloc / 2
                 : 8);
-        new_substr_types = (MD_TEXTTYPE*) realloc(build->substr_types,
-                                    build->substr_alloc * sizeof(MD_TEXTTYPE));
-        if(new_substr_types == NULL) {
+        new_substrs = (char*) md_arena_realloc(ctx, &ctx->block_arena, build->substr_offsets,
+                    (old_alloc > 0 ? (old_alloc+1) * sizeof(OFF) + old_alloc * sizeof(MD_TEXTTYPE) : 0),
+                    (build->substr_alloc+1) * sizeof(OFF) + build->substr_alloc * sizeof(MD_TEXTTYPE));
+        if(new_substrs == NULL) {
             MD_LOG("realloc() failed.");
             return -1;
         }
-        /* Note +1 to reserve space for final offset (== raw_size). */
-        new_substr_offsets = (OFF*) realloc(build->substr_offsets,
-                                    (build->substr_alloc+1) * sizeof(OFF));
-        if(new_substr_offsets == NULL) {
-            MD_LOG("realloc() failed.");
-            free(new_substr_types);
-            return -1;
+        /* The offsets grew into where the types were. */
+        if(old_alloc > 0) {
+            memmove(new_substrs + (build->substr_alloc+1) * sizeof(OFF),
+                    new_substrs + (old_alloc+1) * sizeof(OFF), old_alloc * sizeof(MD_TEXTTYPE));
         }
 
-        build->substr_types = new_substr_types;
-        build->substr_offsets = new_substr_offsets;
+        build->substr_offsets = (OFF*) new_substrs;
+        build->substr_types = (MD_TEXTTYPE*) (new_substrs + (build->substr_alloc+1) * sizeof(OFF));
     }
 
     build->substr_types[build->substr_count] = type;
@@ -1459,18 +1416,6 @@ md_build_attr_append_substr(MD_CTX* ctx, MD_ATTRIBUTE_BUILD* build,
     return 0;
 }
 
-static void
-md_free_attribute(MD_CTX* ctx, MD_ATTRIBUTE_BUILD* build)
-{
-    MD_UNUSED(ctx);
-
-    if(build->substr_alloc > 0) {
-        free(build->text);
-        free(build->substr_types);
-        free(build->substr_offsets);
-    }
-}
-
 static int
 md_build_attribute(MD_CTX* ctx, const CHAR* raw_text, SZ raw_size,
                    unsigned flags, MD_ATTRIBUTE* attr, MD_ATTRIBUTE_BUILD* build)
@@ -1482,7 +1427,8 @@ md_build_attribute(MD_CTX* ctx, const CHAR* raw_text, SZ raw_size,
     memset(build, 0, sizeof(MD_ATTRIBUTE_BUILD));
 
     /* If there is no backslash and no ampersand, build trivial attribute
-     * without any malloc(). */
+     * without any allocation. Otherwise all the memory comes from the block
+     * arena, so it does not have to be freed. */
     is_trivial = TRUE;
     for(raw_off = 0; raw_off < raw_size; raw_off++) {
         if(ISANYOF3_(raw_text[raw_off], _T('\\'), _T('&'), _T('\0'))) {
@@ -1502,7 +1448,7 @@ md_build_attribute(MD_CTX* ctx, const CHAR* raw_text, SZ raw_size,
         build->trivial_offsets[1] = raw_size;
         off = raw_size;
     } else {
-        build->text = (CHAR*) malloc(raw_size * sizeof(CHAR));
+        build->text = (CHAR*) md_arena_alloc(ctx, &ctx->block_arena, raw_size * sizeof(CHAR));
         if(build->text == NULL) {
             MD_LOG("malloc() failed.");
             goto abort;
@@ -1552,7 +1498,6 @@ md_build_attribute(MD_CTX* ctx, const CHAR* raw_text, SZ raw_size,
     return 0;
 
 abort:
-    md_free_attribute(ctx, build);
     return -1;
 }
 
@@ -1583,114 +1528,94 @@ md_fnv1a(unsigned base, const void* data, size_t n)
 struct MD_REF_DEF_tag {
     CHAR* label;
     CHAR* title;
+    const CHAR* dest;       /* Raw destination in the source text (of the document or of a MD_REF_LIBRARY). */
+    unsigned* key;          /* Normalized label, see md_link_label_key(). */
     unsigned hash;
+    SZ key_size;
     SZ label_size;
     SZ title_size;
-    OFF dest_beg;
-    OFF dest_end;
-    unsigned char label_needs_free : 1;
-    unsigned char title_needs_free : 1;
+    SZ dest_size;
 };
 
 /* Label equivalence is quite complicated with regards to whitespace and case
- * folding. This complicates computing a hash of it as well as direct comparison
- * of two labels. */
-
-static unsigned
-md_link_label_hash(const CHAR* label, SZ size)
+ * folding. So each label is normalized just once into a key: a sequence of
+ * case-folded codepoints with leading and trailing whitespace stripped and
+ * any inner whitespace run collapsed into a single space. Equivalent labels
+ * then have identical keys, which can be hashed and compared with memcmp().
+ *
+ * Returns the key allocated from the given arena (NULL on failure) and its
+ * length in *p_key_size. */
+static unsigned*
+md_link_label_key(MD_CTX* ctx, MD_ARENA* arena, const CHAR* label, SZ size, SZ* p_key_size)
 {
-    unsigned hash = MD_FNV1A_BASE;
+    unsigned* key;
+    SZ key_size = 0;
+    int is_ascii = TRUE;
+    int pending_space = FALSE;
     OFF off;
-    unsigned codepoint;
-    int is_whitespace = FALSE;
 
-    off = md_skip_unicode_whitespace(label, 0, size);
-    while(off < size) {
-        SZ char_size;
+    for(off = 0; off < size; off++) {
+        if((unsigned) label[off] > 0x7f) {
+            is_ascii = FALSE;
+            break;
+        }
+    }
 
-        codepoint = md_decode_unicode(label, off, size, &char_size);
-        is_whitespace = ISUNICODEWHITESPACE_(codepoint) || ISNEWLINE_(label[off]);
+    /* A codepoint folds into at most 3 codepoints. */
+    key = (unsigned*) md_arena_alloc(ctx, arena, (is_ascii ? size : 3 * size) * sizeof(unsigned));
+    if(key == NULL)
+        return NULL;
 
-        if(is_whitespace) {
-            codepoint = ' ';
-            hash = md_fnv1a(hash, &codepoint, sizeof(unsigned));
-            off = md_skip_unicode_whitespace(label, off, size);
-        } else {
+    if(is_ascii) {
+        /* Fast path: no decoding, and folding is just lower-casing. */
+        for(off = 0; off < size; off++) {
+            unsigned ch = (unsigned) label[off];
+
+            if(ISWHITESPACE_(ch) || ISNEWLINE_(ch)) {
+                pending_space = (key_size > 0);
+                continue;
+            }
+            if(pending_space) {
+                key[key_size++] = _T(' ');
+                pending_space = FALSE;
+            }
+            key[key_size++] = (ISUPPER_(ch) ? ch + ('a' - 'A') : ch);
+        }
+    } else {
+        off = 0;
+        while(off < size) {
+            SZ char_size;
+            unsigned codepoint;
             MD_UNICODE_FOLD_INFO fold_info;
+            unsigned i;
 
+            codepoint = md_decode_unicode(label, off, size, &char_size);
+            if(ISUNICODEWHITESPACE_(codepoint) || ISNEWLINE_(label[off])) {
+                pending_space = (key_size > 0);
+                off += char_size;
+                continue;
+            }
+            if(pending_space) {
+                key[key_size++] = _T(' ');
+                pending_space = FALSE;
+            }
             md_get_unicode_fold_info(codepoint, &fold_info);
-            hash = md_fnv1a(hash, fold_info.codepoints, fold_info.n_codepoints * sizeof(unsigned));
+            for(i = 0; i < fold_info.n_codepoints; i++)
+                key[key_size++] = fold_info.codepoints[i];
             off += char_size;
         }
     }
 
-    return hash;
-}
-
-static OFF
-md_link_label_cmp_load_fold_info(const CHAR* label, OFF off, SZ size,
-                                 MD_UNICODE_FOLD_INFO* fold_info)
-{
-    unsigned codepoint;
-    SZ char_size;
-
-    if(off >= size) {
-        /* Treat end of a link label as a whitespace. */
-        goto whitespace;
-    }
-
-    codepoint = md_decode_unicode(label, off, size, &char_size);
-    off += char_size;
-    if(ISUNICODEWHITESPACE_(codepoint)) {
-        /* Treat all whitespace as equivalent */
-        goto whitespace;
-    }
-
-    /* Get real folding info. */
-    md_get_unicode_fold_info(codepoint, fold_info);
-    return off;
-
-whitespace:
-    fold_info->codepoints[0] = _T(' ');
-    fold_info->n_codepoints = 1;
-    return md_skip_unicode_whitespace(label, off, size);
+    *p_key_size = key_size;
+    return key;
 }
 
-static int
-md_link_label_cmp(const CHAR* a_label, SZ a_size, const CHAR* b_label, SZ b_size)
+static inline int
+md_link_label_key_cmp(const unsigned* a_key, SZ a_size, const unsigned* b_key, SZ b_size)
 {
-    OFF a_off;
-    OFF b_off;
-    MD_UNICODE_FOLD_INFO a_fi = { { 0 }, 0 };
-    MD_UNICODE_FOLD_INFO b_fi = { { 0 }, 0 };
-    OFF a_fi_off = 0;
-    OFF b_fi_off = 0;
-    int cmp;
-
-    a_off = md_skip_unicode_whitespace(a_label, 0, a_size);
-    b_off = md_skip_unicode_whitespace(b_label, 0, b_size);
-    while(a_off < a_size || a_fi_off < a_fi.n_codepoints ||
-          b_off < b_size || b_fi_off < b_fi.n_codepoints)
-    {
-        /* If needed, load fold info for next char. */
-        if(a_fi_off >= a_fi.n_codepoints) {
-            a_fi_off = 0;
-            a_off = md_link_label_cmp_load_fold_info(a_label, a_off, a_size, &a_fi);
-        }
-        if(b_fi_off >= b_fi.n_codepoints) {
-            b_fi_off = 0;
-            b_off = md_link_label_cmp_load_fold_info(b_label, b_off, b_size, &b_fi);
-        }
-
-        cmp = b_fi.codepoints[b_fi_off] - a_fi.codepoints[a_fi_off];
-        if(cmp != 0)
-            return cmp;
-
-        a_fi_off++;
-        b_fi_off++;
-    }
-
-    return 0;
+    if(a_size != b_size)
+        return (a_size < b_size ? -1 : +1);
+    return memcmp(a_key, b_key, a_size * sizeof(unsigned));
 }
 
 typedef struct MD_REF_DEF_LIST_tag MD_REF_DEF_LIST;
@@ -1700,6 +1625,20 @@ struct MD_REF_DEF_LIST_tag {
     MD_REF_DEF* ref_defs[];  /* Valid items always  point into ctx->ref_defs[] */
 };
 
+/* The reference definitions and their hashtable taken over from the MD_CTX
+ * which parsed the library's text. */
+struct MD_REF_LIBRARY {
+    const MD_ALLOCATOR* allocator;
+    CHAR* text;             /* Own copy of the source. Labels, titles and destinations point into it. */
+    MD_REF_DEF* ref_defs;
+    int n_ref_defs;
+    unsigned n_labels;
+    void** ref_def_hashtable;
+    int ref_def_hashtable_size;
+    MD_ARENA arena;         /* Merged multi-line labels and titles, and all the keys. */
+    SZ def_output_size;     /* Label, title and destination sizes of all the definitions. */
+};
+
 static int
 md_ref_def_cmp(const void* a, const void* b)
 {
@@ -1711,7 +1650,7 @@ md_ref_def_cmp(const void* a, const void* b)
     else if(a_ref->hash > b_ref->hash)
         return +1;
     else
-        return md_link_label_cmp(a_ref->label, a_ref->label_size, b_ref->label, b_ref->label_size);
+        return md_link_label_key_cmp(a_ref->key, a_ref->key_size, b_ref->key, b_ref->key_size);
 }
 
 static int
@@ -1746,7 +1685,7 @@ md_build_ref_def_hashtable(MD_CTX* ctx)
         return 0;
 
     ctx->ref_def_hashtable_size = (ctx->n_ref_defs * 5) / 4;
-    ctx->ref_def_hashtable = malloc(ctx->ref_def_hashtable_size * sizeof(void*));
+    ctx->ref_def_hashtable = md_malloc(ctx, ctx->ref_def_hashtable_size * sizeof(void*));
     if(ctx->ref_def_hashtable == NULL) {
         MD_LOG("malloc() failed.");
         goto abort;
@@ -1764,7 +1703,10 @@ md_build_ref_def_hashtable(MD_CTX* ctx)
         void* bucket;
         MD_REF_DEF_LIST* list;
 
-        def->hash = md_link_label_hash(def->label, def->label_size);
+        def->key = md_link_label_key(ctx, &ctx->doc_arena, def->label, def->label_size, &def->key_size);
+        if(def->key == NULL)
+            goto abort;
+        def->hash = md_fnv1a(MD_FNV1A_BASE, def->key, def->key_size * sizeof(unsigned));
         bucket = ctx->ref_def_hashtable[def->hash % ctx->ref_def_hashtable_size];
 
         if(bucket == NULL) {
@@ -1779,13 +1721,13 @@ md_build_ref_def_hashtable(MD_CTX* ctx)
              * (hash conflict). */
             MD_REF_DEF* old_def = (MD_REF_DEF*) bucket;
 
-            if(md_link_label_cmp(def->label, def->label_size, old_def->label, old_def->label_size) == 0) {
+            if(md_link_label_key_cmp(def->key, def->key_size, old_def->key, old_def->key_size) == 0) {
                 /* Duplicate label: Ignore this ref. def. */
                 continue;
             }
 
             /* Make the bucket complex, i.e. able to hold more ref. defs. */
-            list = (MD_REF_DEF_LIST*) malloc(sizeof(MD_REF_DEF_LIST) + 2 * sizeof(MD_REF_DEF*));
+            list = (MD_REF_DEF_LIST*) md_malloc(ctx, sizeof(MD_REF_DEF_LIST) + 2 * sizeof(MD_REF_DEF*));
             if(list == NULL) {
                 MD_LOG("malloc() failed.");
                 goto abort;
@@ -1807,7 +1749,7 @@ md_build_ref_def_hashtable(MD_CTX* ctx)
         list = (MD_REF_DEF_LIST*) bucket;
         if(list->n_ref_defs >= list->alloc_ref_defs) {
             int alloc_ref_defs = list->alloc_ref_defs + list->alloc_ref_defs / 2;
-            MD_REF_DEF_LIST* list_tmp = (MD_REF_DEF_LIST*) realloc(list,
+            MD_REF_DEF_LIST* list_tmp = (MD_REF_DEF_LIST*) md_realloc(ctx, list,
                         sizeof(MD_REF_DEF_LIST) + alloc_ref_defs * sizeof(MD_REF_DEF*));
             if(list_tmp == NULL) {
                 MD_LOG("realloc() failed.");
@@ -1863,44 +1805,40 @@ md_free_ref_def_hashtable(MD_CTX* ctx)
                 continue;
             if(ctx->ref_defs <= (MD_REF_DEF*) bucket  &&  (MD_REF_DEF*) bucket < ctx->ref_defs + ctx->n_ref_defs)
                 continue;
-            free(bucket);
+            md_free(ctx, bucket);
         }
 
-        free(ctx->ref_def_hashtable);
+        md_free(ctx, ctx->ref_def_hashtable);
     }
 }
 
+/* Looks up the key in a hashtable built by md_build_ref_def_hashtable() over
+ * the given ref_defs[]. */
 static const MD_REF_DEF*
-md_lookup_ref_def(MD_CTX* ctx, const CHAR* label, SZ label_size)
+md_lookup_ref_def_in(const MD_REF_DEF* ref_defs, int n_ref_defs,
+                     void** ref_def_hashtable, int ref_def_hashtable_size, const MD_REF_DEF* key)
 {
-    unsigned hash;
     void* bucket;
 
-    if(ctx->ref_def_hashtable_size == 0)
+    if(ref_def_hashtable_size == 0)
         return NULL;
 
-    hash = md_link_label_hash(label, label_size);
-    bucket = ctx->ref_def_hashtable[hash % ctx->ref_def_hashtable_size];
+    bucket = ref_def_hashtable[key->hash % ref_def_hashtable_size];
 
     if(bucket == NULL) {
         return NULL;
-    } else if(ctx->ref_defs <= (MD_REF_DEF*) bucket  &&  (MD_REF_DEF*) bucket < ctx->ref_defs + ctx->n_ref_defs) {
+    } else if(ref_defs <= (MD_REF_DEF*) bucket  &&  (MD_REF_DEF*) bucket < ref_defs + n_ref_defs) {
         const MD_REF_DEF* def = (MD_REF_DEF*) bucket;
 
-        if(md_link_label_cmp(def->label, def->label_size, label, label_size) == 0)
+        if(def->hash == key->hash  &&
+           md_link_label_key_cmp(def->key, def->key_size, key->key, key->key_size) == 0)
             return def;
         else
             return NULL;
     } else {
         MD_REF_DEF_LIST* list = (MD_REF_DEF_LIST*) bucket;
-        MD_REF_DEF key_buf;
-        const MD_REF_DEF* key = &key_buf;
         const MD_REF_DEF** ret;
 
-        key_buf.label = (CHAR*) label;
-        key_buf.label_size = label_size;
-        key_buf.hash = md_link_label_hash(key_buf.label, key_buf.label_size);
-
         ret = (const MD_REF_DEF**) bsearch(&key, list->ref_defs,
                     list->n_ref_defs, sizeof(MD_REF_DEF*), md_ref_def_cmp);
         if(ret != NULL)
@@ -1910,6 +1848,42 @@ md_lookup_ref_def(MD_CTX* ctx, const CHAR* label, SZ label_size)
     }
 }
 
+static const MD_REF_DEF*
+md_lookup_ref_def(MD_CTX* ctx, const CHAR* label, SZ label_size, int* p_from_library)
+{
+    const MD_REF_LIBRARY* library = ctx->parser.ref_library;
+    MD_ARENA_MARK arena_mark;
+    MD_REF_DEF key_buf;
+    const MD_REF_DEF* def = NULL;
+
+    if(ctx->ref_def_hashtable_size == 0  &&  library == NULL)
+        return NULL;
+
+    /* The key is only needed for this lookup. */
+    arena_mark = md_arena_mark(&ctx->block_arena);
+    key_buf.key = md_link_label_key(ctx, &ctx->block_arena, label, label_size, &key_buf.key_size);
+    if(key_buf.key == NULL)
+        goto out;
+    key_buf.hash = md_fnv1a(MD_FNV1A_BASE, key_buf.key, key_buf.key_size * sizeof(unsigned));
+
+    /* The document's own definitions take precedence over the library. */
+    def = md_lookup_ref_def_in(ctx->ref_defs, ctx->n_ref_defs,
+                ctx->ref_def_hashtable, ctx->ref_def_hashtable_size, &key_buf);
+    if(def == NULL  &&  library != NULL) {
+        def = md_lookup_ref_def_in(library->ref_defs, library->n_ref_defs,
+                    library->ref_def_hashtable, library->ref_def_hashtable_size, &key_buf);
+        ctx->ref_library_lookups++;
+        if(def != NULL) {
+            ctx->ref_library_hits++;
+            *p_from_library = TRUE;
+        }
+    }
+
+out:
+    md_arena_rewind(&ctx->block_arena, arena_mark);
+    return def;
+}
+
 
 /***************************
  ***  Recognizing Links  ***
@@ -1921,12 +1895,11 @@ md_lookup_ref_def(MD_CTX* ctx, const CHAR* label, SZ label_size)
 
 typedef struct MD_LINK_ATTR_tag MD_LINK_ATTR;
 struct MD_LINK_ATTR_tag {
-    OFF dest_beg;
-    OFF dest_end;
+    const CHAR* dest;
+    SZ dest_size;
 
     CHAR* title;
     SZ title_size;
-    int title_needs_free;
 };
 
 
@@ -2232,7 +2205,7 @@ md_is_link_reference_definition(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lin
         ctx->alloc_ref_defs = (ctx->alloc_ref_defs > 0
                 ? ctx->alloc_ref_defs + ctx->alloc_ref_defs / 2
                 : 16);
-        new_defs = (MD_REF_DEF*) realloc(ctx->ref_defs, ctx->alloc_ref_defs * sizeof(MD_REF_DEF));
+        new_defs = (MD_REF_DEF*) md_realloc(ctx, ctx->ref_defs, ctx->alloc_ref_defs * sizeof(MD_REF_DEF));
         if(new_defs == NULL) {
             MD_LOG("realloc() failed.");
             goto abort;
@@ -2244,38 +2217,32 @@ md_is_link_reference_definition(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lin
     memset(def, 0, sizeof(MD_REF_DEF));
 
     if(label_is_multiline) {
-        MD_CHECK(md_merge_lines_alloc(ctx, label_contents_beg, label_contents_end,
+        MD_CHECK(md_merge_lines_alloc(ctx, &ctx->doc_arena, label_contents_beg, label_contents_end,
                     lines + label_contents_line_index, n_lines - label_contents_line_index,
                     _T(' '), &def->label, &def->label_size));
-        def->label_needs_free = TRUE;
     } else {
         def->label = (CHAR*) STR(label_contents_beg);
         def->label_size = label_contents_end - label_contents_beg;
     }
 
     if(title_is_multiline) {
-        MD_CHECK(md_merge_lines_alloc(ctx, title_contents_beg, title_contents_end,
+        MD_CHECK(md_merge_lines_alloc(ctx, &ctx->doc_arena, title_contents_beg, title_contents_end,
                     lines + title_contents_line_index, n_lines - title_contents_line_index,
                     _T('\n'), &def->title, &def->title_size));
-        def->title_needs_free = TRUE;
     } else {
         def->title = (CHAR*) STR(title_contents_beg);
         def->title_size = title_contents_end - title_contents_beg;
     }
 
-    def->dest_beg = dest_contents_beg;
-    def->dest_end = dest_contents_end;
+    def->dest = STR(dest_contents_beg);
+    def->dest_size = dest_contents_end - dest_contents_beg;
 
     /* Success. */
     ctx->n_ref_defs++;
     return line_index + 1;
 
 abort:
-    /* Failure. */
-    if(def != NULL  &&  def->label_needs_free)
-        free(def->label);
-    if(def != NULL  &&  def->title_needs_free)
-        free(def->title);
+    /* Failure. Anything merged into the doc arena is released with it. */
     return ret;
 }
 
@@ -2288,12 +2255,14 @@ md_is_link_reference(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines,
     int is_multiline;
     CHAR* label;
     SZ label_size;
+    int from_library = FALSE;
+    SZ* max_output;
     int ret = FALSE;
 
     MD_ASSERT(CH(beg) == _T('[') || CH(beg) == _T('!'));
     MD_ASSERT(CH(end-1) == _T(']'));
 
-    if(ctx->max_ref_def_output == 0)
+    if(ctx->max_ref_def_output == 0  &&  ctx->max_ref_library_output == 0)
         return FALSE;
 
     beg += (CH(beg) == _T('!') ? 2 : 1);
@@ -2304,34 +2273,33 @@ md_is_link_reference(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines,
     is_multiline = (end > beg_line->end);
 
     if(is_multiline) {
-        MD_CHECK(md_merge_lines_alloc(ctx, beg, end, beg_line,
+        MD_CHECK(md_merge_lines_alloc(ctx, &ctx->block_arena, beg, end, beg_line,
                  (int)(n_lines - (beg_line - lines)), _T(' '), &label, &label_size));
     } else {
         label = (CHAR*) STR(beg);
         label_size = end - beg;
     }
 
-    def = md_lookup_ref_def(ctx, label, label_size);
+    def = md_lookup_ref_def(ctx, label, label_size, &from_library);
     if(def != NULL) {
-        attr->dest_beg = def->dest_beg;
-        attr->dest_end = def->dest_end;
+        attr->dest = def->dest;
+        attr->dest_size = def->dest_size;
         attr->title = def->title;
         attr->title_size = def->title_size;
-        attr->title_needs_free = FALSE;
     }
 
-    if(is_multiline)
-        free(label);
-
     if(def != NULL) {
-        /* See https://github.com/mity/md4c/issues/238 */
-        MD_SIZE output_size_estimation = def->label_size + def->title_size + def->dest_end - def->dest_beg;
-        if(output_size_estimation < ctx->max_ref_def_output) {
-            ctx->max_ref_def_output -= output_size_estimation;
+        /* See https://github.com/mity/md4c/issues/238. Library definitions
+         * have a budget of their own, so a short document can still use
+         * long ones, and using them up doesn't stop the document's own. */
+        MD_SIZE output_size_estimation = def->label_size + def->title_size + def->dest_size;
+        max_output = (from_library ? &ctx->max_ref_library_output : &ctx->max_ref_def_output);
+        if(output_size_estimation < *max_output) {
+            *max_output -= output_size_estimation;
             ret = TRUE;
         } else {
             MD_LOG("Too many link reference definition instantiations.");
-            ctx->max_ref_def_output = 0;
+            *max_output = 0;
         }
     }
 
@@ -2345,6 +2313,8 @@ md_is_inline_link_spec(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines,
 {
     MD_SIZE line_index = 0;
     MD_SIZE tmp_line_index;
+    OFF dest_contents_beg;
+    OFF dest_contents_end;
     OFF title_contents_beg;
     OFF title_contents_end;
     MD_SIZE title_contents_line_index;
@@ -2369,11 +2339,10 @@ md_is_inline_link_spec(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines,
 
     /* Link destination may be omitted, but only when not also having a title. */
     if(off < ctx->size  &&  CH(off) == _T(')')) {
-        attr->dest_beg = off;
-        attr->dest_end = off;
+        attr->dest = STR(off);
+        attr->dest_size = 0;
         attr->title = NULL;
         attr->title_size = 0;
-        attr->title_needs_free = FALSE;
         off++;
         *p_end = off;
         return TRUE;
@@ -2381,8 +2350,10 @@ md_is_inline_link_spec(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines,
 
     /* Link destination. */
     if(!md_is_link_destination(ctx, off, lines[line_index].end,
-                        &off, &attr->dest_beg, &attr->dest_end))
+                        &off, &dest_contents_beg, &dest_contents_end))
         return FALSE;
+    attr->dest = STR(dest_contents_beg);
+    attr->dest_size = dest_contents_end - dest_contents_beg;
 
     /* (Optional) title. */
     if(md_is_link_title(ctx, lines + line_index, n_lines - line_index, off,
@@ -2416,16 +2387,13 @@ md_is_inline_link_spec(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines,
     if(title_contents_beg >= title_contents_end) {
         attr->title = NULL;
         attr->title_size = 0;
-        attr->title_needs_free = FALSE;
     } else if(!title_is_multiline) {
         attr->title = (CHAR*) STR(title_contents_beg);
         attr->title_size = title_contents_end - title_contents_beg;
-        attr->title_needs_free = FALSE;
     } else {
-        MD_CHECK(md_merge_lines_alloc(ctx, title_contents_beg, title_contents_end,
+        MD_CHECK(md_merge_lines_alloc(ctx, &ctx->block_arena, title_contents_beg, title_contents_end,
                     lines + title_contents_line_index, n_lines - title_contents_line_index,
                     _T('\n'), &attr->title, &attr->title_size));
-        attr->title_needs_free = TRUE;
     }
 
     *p_end = off;
@@ -2438,18 +2406,8 @@ abort:
 static void
 md_free_ref_defs(MD_CTX* ctx)
 {
-    int i;
-
-    for(i = 0; i < ctx->n_ref_defs; i++) {
-        MD_REF_DEF* def = &ctx->ref_defs[i];
-
-        if(def->label_needs_free)
-            free(def->label);
-        if(def->title_needs_free)
-            free(def->title);
-    }
-
-    free(ctx->ref_defs);
+    /* Labels and titles merged from multiple lines are in ctx->doc_arena. */
+    md_free(ctx, ctx->ref_defs);
 }
 
 
@@ -2598,13 +2556,19 @@ md_opener_stack(MD_CTX* ctx, int mark_index)
 static MD_MARK*
 md_add_mark(MD_CTX* ctx)
 {
+    if(ctx->parser.max_marks > 0  &&  ctx->n_marks >= (int) ctx->parser.max_marks) {
+        MD_LOG("Too many inline marks.");
+        ctx->limit_exceeded = TRUE;
+        return NULL;
+    }
+
     if(ctx->n_marks >= ctx->alloc_marks) {
         MD_MARK* new_marks;
 
         ctx->alloc_marks = (ctx->alloc_marks > 0
                 ? ctx->alloc_marks + ctx->alloc_marks / 2
                 : 64);
-        new_marks = realloc(ctx->marks, ctx->alloc_marks * sizeof(MD_MARK));
+        new_marks = md_realloc(ctx, ctx->marks, ctx->alloc_marks * sizeof(MD_MARK));
         if(new_marks == NULL) {
             MD_LOG("realloc() failed.");
             return NULL;
@@ -2620,7 +2584,7 @@ md_add_mark(MD_CTX* ctx)
         do {                                                            \
             mark = md_add_mark(ctx);                                    \
             if(mark == NULL) {                                          \
-                ret = -1;                                               \
+                ret = (ctx->limit_exceeded ? MD_LIMIT_EXCEEDED : -1);   \
                 goto abort;                                             \
             }                                                           \
         } while(0)
@@ -2745,25 +2709,25 @@ md_build_mark_char_map(MD_CTX* ctx)
     ctx->mark_char_map[']'] = 1;
     ctx->mark_char_map['\0'] = 1;
 
-    if(ctx->parser.flags & MD_FLAG_STRIKETHROUGH)
+    if(MD_FLAGS(ctx) & MD_FLAG_STRIKETHROUGH)
         ctx->mark_char_map['~'] = 1;
 
-    if(ctx->parser.flags & MD_FLAG_LATEXMATHSPANS)
+    if(MD_FLAGS(ctx) & MD_FLAG_LATEXMATHSPANS)
         ctx->mark_char_map['$'] = 1;
 
-    if(ctx->parser.flags & MD_FLAG_PERMISSIVEEMAILAUTOLINKS)
+    if(MD_FLAGS(ctx) & MD_FLAG_PERMISSIVEEMAILAUTOLINKS)
         ctx->mark_char_map['@'] = 1;
 
-    if(ctx->parser.flags & MD_FLAG_PERMISSIVEURLAUTOLINKS)
+    if(MD_FLAGS(ctx) & MD_FLAG_PERMISSIVEURLAUTOLINKS)
         ctx->mark_char_map[':'] = 1;
 
-    if(ctx->parser.flags & MD_FLAG_PERMISSIVEWWWAUTOLINKS)
+    if(MD_FLAGS(ctx) & MD_FLAG_PERMISSIVEWWWAUTOLINKS)
         ctx->mark_char_map['.'] = 1;
 
-    if((ctx->parser.flags & MD_FLAG_TABLES) || (ctx->parser.flags & MD_FLAG_WIKILINKS))
+    if((MD_FLAGS(ctx) & MD_FLAG_TABLES) || (MD_FLAGS(ctx) & MD_FLAG_WIKILINKS))
         ctx->mark_char_map['|'] = 1;
 
-    if(ctx->parser.flags & MD_FLAG_COLLAPSEWHITESPACE) {
+    if(MD_FLAGS(ctx) & MD_FLAG_COLLAPSEWHITESPACE) {
         int i;
 
         for(i = 0; i < (int) sizeof(ctx->mark_char_map); i++) {
@@ -3163,7 +3127,7 @@ md_collect_marks(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines, int table_m
                 OFF autolink_end;
                 int missing_mailto;
 
-                if(!(ctx->parser.flags & MD_FLAG_NOHTMLSPANS)) {
+                if(!(MD_FLAGS(ctx) & MD_FLAG_NOHTMLSPANS)) {
                     int is_html;
                     OFF html_end;
 
@@ -3289,7 +3253,7 @@ md_collect_marks(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines, int table_m
             }
 
             /* A potential table cell boundary or wiki link label delimiter. */
-            if((table_mode || ctx->parser.flags & MD_FLAG_WIKILINKS) && ch == _T('|')) {
+            if((table_mode || MD_FLAGS(ctx) & MD_FLAG_WIKILINKS) && ch == _T('|')) {
                 ADD_MARK(ch, off, off+1, 0);
                 off++;
                 continue;
@@ -3445,7 +3409,7 @@ md_resolve_links(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines)
         /* Recognize and resolve wiki links.
          * Wiki-links maybe '[[destination]]' or '[[destination|label]]'.
          */
-        if ((ctx->parser.flags & MD_FLAG_WIKILINKS) &&
+        if ((MD_FLAGS(ctx) & MD_FLAG_WIKILINKS) &&
             (opener->end - opener->beg == 1) &&         /* not image */
             next_opener != NULL &&                      /* double '[' opener */
             next_opener->ch == '[' &&
@@ -3575,8 +3539,6 @@ md_resolve_links(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines)
                         if((mark->flags & (MD_MARK_OPENER | MD_MARK_RESOLVED)) == (MD_MARK_OPENER | MD_MARK_RESOLVED)) {
                             if(ctx->marks[mark->next].beg >= inline_link_end) {
                                 /* Cancel the link status. */
-                                if(attr.title_needs_free)
-                                    free(attr.title);
                                 is_link = FALSE;
                                 break;
                             }
@@ -3609,16 +3571,16 @@ md_resolve_links(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines)
             closer->flags |= MD_MARK_CLOSER | MD_MARK_RESOLVED;
 
             /* If it is a link, we store the destination and title in the two
-             * dummy marks after the opener. */
+             * dummy marks after the opener. The destination may come from
+             * a MD_REF_LIBRARY, so it is stored as a pointer too. */
             MD_ASSERT(ctx->marks[opener_index+1].ch == 'D');
-            ctx->marks[opener_index+1].beg = attr.dest_beg;
-            ctx->marks[opener_index+1].end = attr.dest_end;
+            md_mark_store_ptr(ctx, opener_index+1, (void*) attr.dest);
+            ctx->marks[opener_index+1].prev = attr.dest_size;
 
             MD_ASSERT(ctx->marks[opener_index+2].ch == 'D');
+            /* The title might have been allocated in the block arena, which
+             * outlives all the callbacks for this block. */
             md_mark_store_ptr(ctx, opener_index+2, attr.title);
-            /* The title might or might not have been allocated for us. */
-            if(attr.title_needs_free)
-                md_mark_stack_push(ctx, &ctx->ptr_stack, opener_index+2);
             ctx->marks[opener_index+2].prev = attr.title_size;
 
             if(opener->ch == '[') {
@@ -3634,7 +3596,7 @@ md_resolve_links(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines)
             /* If the link text is formed by nothing but permissive autolink,
              * suppress the autolink.
              * See https://github.com/mity/md4c/issues/152 for more info. */
-            if(ctx->parser.flags & MD_FLAG_PERMISSIVEAUTOLINKS) {
+            if(MD_FLAGS(ctx) & MD_FLAG_PERMISSIVEAUTOLINKS) {
                 MD_MARK* first_nested;
                 MD_MARK* last_nested;
 
@@ -4143,7 +4105,7 @@ md_analyze_link_contents(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines,
     md_analyze_marks(ctx, lines, n_lines, mark_beg, mark_end, _T("&"), 0);
     md_analyze_marks(ctx, lines, n_lines, mark_beg, mark_end, _T("*_~$"), 0);
 
-    if((ctx->parser.flags & MD_FLAG_PERMISSIVEAUTOLINKS) != 0) {
+    if((MD_FLAGS(ctx) & MD_FLAG_PERMISSIVEAUTOLINKS) != 0) {
         /* These have to be processed last, as they may be greedy and expand
          * from their original mark. Also their implementation must be careful
          * not to cross any (previously) resolved marks when doing so. */
@@ -4161,6 +4123,7 @@ md_enter_leave_span_a(MD_CTX* ctx, int enter, MD_SPANTYPE type,
 {
     MD_ATTRIBUTE_BUILD href_build = { 0 };
     MD_ATTRIBUTE_BUILD title_build = { 0 };
+    MD_ARENA_MARK arena_mark = md_arena_mark(&ctx->block_arena);
     MD_SPAN_A_DETAIL det;
     int ret = 0;
 
@@ -4178,8 +4141,8 @@ md_enter_leave_span_a(MD_CTX* ctx, int enter, MD_SPANTYPE type,
         MD_LEAVE_SPAN(type, &det);
 
 abort:
-    md_free_attribute(ctx, &href_build);
-    md_free_attribute(ctx, &title_build);
+    /* The attributes are only needed during the callback. */
+    md_arena_rewind(&ctx->block_arena, arena_mark);
     return ret;
 }
 
@@ -4187,6 +4150,7 @@ static int
 md_enter_leave_span_wikilink(MD_CTX* ctx, int enter, const CHAR* target, SZ target_size)
 {
     MD_ATTRIBUTE_BUILD target_build = { 0 };
+    MD_ARENA_MARK arena_mark = md_arena_mark(&ctx->block_arena);
     MD_SPAN_WIKILINK_DETAIL det;
     int ret = 0;
 
@@ -4199,7 +4163,7 @@ md_enter_leave_span_wikilink(MD_CTX* ctx, int enter, const CHAR* target, SZ targ
         MD_LEAVE_SPAN(MD_SPAN_WIKILINK, &det);
 
 abort:
-    md_free_attribute(ctx, &target_build);
+    md_arena_rewind(&ctx->block_arena, arena_mark);
     return ret;
 }
 
@@ -4261,7 +4225,7 @@ md_process_inlines(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines)
                     break;
 
                 case '_':       /* Underline (or emphasis if we fall through). */
-                    if(ctx->parser.flags & MD_FLAG_UNDERLINE) {
+                    if(MD_FLAGS(ctx) & MD_FLAG_UNDERLINE) {
                         if(mark->flags & MD_MARK_OPENER) {
                             while(off < mark->end) {
                                 MD_ENTER_SPAN(MD_SPAN_U, NULL);
@@ -4351,7 +4315,7 @@ md_process_inlines(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines)
 
                     MD_CHECK(md_enter_leave_span_a(ctx, (mark->ch != ']'),
                                 (opener->ch == '!' ? MD_SPAN_IMG : MD_SPAN_A),
-                                STR(dest_mark->beg), dest_mark->end - dest_mark->beg, FALSE,
+                                (const CHAR*) md_mark_get_ptr(ctx, (int)(dest_mark - ctx->marks)), dest_mark->prev, FALSE,
                                 md_mark_get_ptr(ctx, (int)(title_mark - ctx->marks)),
 								title_mark->prev));
 
@@ -4470,7 +4434,7 @@ md_process_inlines(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines)
                 MD_TEXTTYPE break_type = MD_TEXT_SOFTBR;
 
                 if(text_type == MD_TEXT_NORMAL) {
-                    if(enforce_hardbreak  ||  (ctx->parser.flags & MD_FLAG_HARD_SOFT_BREAKS)) {
+                    if(enforce_hardbreak  ||  (MD_FLAGS(ctx) & MD_FLAG_HARD_SOFT_BREAKS)) {
                         break_type = MD_TEXT_BR;
                     } else {
                         while(off < ctx->size  &&  ISBLANK(off))
@@ -4566,12 +4530,12 @@ md_process_table_row(MD_CTX* ctx, MD_BLOCKTYPE cell_type, OFF beg, OFF end,
 
     /* Break the line into table cells by identifying pipe characters who
      * form the cell boundary. */
-    MD_CHECK(md_analyze_inlines(ctx, &line, 1, TRUE));
+    MD_TRACE_CHECK("md4c.analyze_inlines", md_analyze_inlines(ctx, &line, 1, TRUE));
 
     /* We have to remember the cell boundaries in local buffer because
      * ctx->marks[] shall be reused during cell contents processing. */
     n = ctx->n_table_cell_boundaries + 2;
-    pipe_offs = (OFF*) malloc(n * sizeof(OFF));
+    pipe_offs = (OFF*) md_malloc(ctx, n * sizeof(OFF));
     if(pipe_offs == NULL) {
         MD_LOG("malloc() failed.");
         ret = -1;
@@ -4599,7 +4563,7 @@ md_process_table_row(MD_CTX* ctx, MD_BLOCKTYPE cell_type, OFF beg, OFF end,
     MD_LEAVE_BLOCK(MD_BLOCK_TR, NULL);
 
 abort:
-    free(pipe_offs);
+    md_free(ctx, pipe_offs);
 
     ctx->table_cell_boundaries_head = -1;
     ctx->table_cell_boundaries_tail = -1;
@@ -4618,7 +4582,7 @@ md_process_table_block_contents(MD_CTX* ctx, int col_count, const MD_LINE* lines
      * with the underlines. */
     MD_ASSERT(n_lines >= 2);
 
-    align = malloc(col_count * sizeof(MD_ALIGN));
+    align = md_malloc(ctx, col_count * sizeof(MD_ALIGN));
     if(align == NULL) {
         MD_LOG("malloc() failed.");
         ret = -1;
@@ -4642,7 +4606,7 @@ md_process_table_block_contents(MD_CTX* ctx, int col_count, const MD_LINE* lines
     }
 
 abort:
-    free(align);
+    md_free(ctx, align);
     return ret;
 }
 
@@ -4690,18 +4654,12 @@ struct MD_CONTAINER_tag {
 static int
 md_process_normal_block_contents(MD_CTX* ctx, const MD_LINE* lines, MD_SIZE n_lines)
 {
-    int i;
     int ret;
 
-    MD_CHECK(md_analyze_inlines(ctx, lines, n_lines, FALSE));
-    MD_CHECK(md_process_inlines(ctx, lines, n_lines));
+    MD_TRACE_CHECK("md4c.analyze_inlines", md_analyze_inlines(ctx, lines, n_lines, FALSE));
+    MD_TRACE_CHECK("md4c.process_inlines", md_process_inlines(ctx, lines, n_lines));
 
 abort:
-    /* Free any temporary memory blocks stored within some dummy marks. */
-    for(i = ctx->ptr_stack.top; i >= 0; i = ctx->marks[i].next)
-        free(md_mark_get_ptr(ctx, i));
-    ctx->ptr_stack.top = -1;
-
     return ret;
 }
 
@@ -4812,7 +4770,6 @@ md_process_leaf_block(MD_CTX* ctx, const MD_BLOCK* block)
     MD_ATTRIBUTE_BUILD info_build;
     MD_ATTRIBUTE_BUILD lang_build;
     int is_in_tight_list;
-    int clean_fence_code_detail = FALSE;
     int ret = 0;
 
     memset(&det, 0, sizeof(det));
@@ -4831,7 +4788,6 @@ md_process_leaf_block(MD_CTX* ctx, const MD_BLOCK* block)
             /* For fenced code block, we may need to set the info string. */
             if(block->data != 0) {
                 memset(&det.code, 0, sizeof(MD_BLOCK_CODE_DETAIL));
-                clean_fence_code_detail = TRUE;
                 MD_CHECK(md_setup_fenced_code_detail(ctx, block, &det.code, &info_build, &lang_build));
             }
             break;
@@ -4881,10 +4837,8 @@ md_process_leaf_block(MD_CTX* ctx, const MD_BLOCK* block)
         MD_LEAVE_BLOCK(block->type, (void*) &det);
 
 abort:
-    if(clean_fence_code_detail) {
-        md_free_attribute(ctx, &info_build);
-        md_free_attribute(ctx, &lang_build);
-    }
+    /* Nothing allocated for this block is referenced anymore. */
+    md_arena_reset(&ctx->block_arena);
     return ret;
 }
 
@@ -4987,7 +4941,7 @@ md_push_block_bytes(MD_CTX* ctx, int n_bytes)
         ctx->alloc_block_bytes = (ctx->alloc_block_bytes > 0
                 ? ctx->alloc_block_bytes + ctx->alloc_block_bytes / 2
                 : 512);
-        new_block_bytes = realloc(ctx->block_bytes, ctx->alloc_block_bytes);
+        new_block_bytes = md_realloc(ctx, ctx->block_bytes, ctx->alloc_block_bytes);
         if(new_block_bytes == NULL) {
             MD_LOG("realloc() failed.");
             return NULL;
@@ -5251,7 +5205,7 @@ md_is_atxheader_line(MD_CTX* ctx, OFF beg, OFF* p_beg, OFF* p_end, unsigned* p_l
         return FALSE;
     *p_level = n;
 
-    if(!(ctx->parser.flags & MD_FLAG_PERMISSIVEATXHEADERS)  &&  off < ctx->size  &&
+    if(!(MD_FLAGS(ctx) & MD_FLAG_PERMISSIVEATXHEADERS)  &&  off < ctx->size  &&
        !ISBLANK(off)  &&  !ISNEWLINE(off))
         return FALSE;
 
@@ -5629,13 +5583,18 @@ md_is_container_compatible(const MD_CONTAINER* pivot, const MD_CONTAINER* contai
 static int
 md_push_container(MD_CTX* ctx, const MD_CONTAINER* container)
 {
+    if(ctx->parser.max_nesting > 0  &&  ctx->n_containers >= (int) ctx->parser.max_nesting) {
+        MD_LOG("Container blocks nested too deep.");
+        return MD_LIMIT_EXCEEDED;
+    }
+
     if(ctx->n_containers >= ctx->alloc_containers) {
         MD_CONTAINER* new_containers;
 
         ctx->alloc_containers = (ctx->alloc_containers > 0
                 ? ctx->alloc_containers + ctx->alloc_containers / 2
                 : 16);
-        new_containers = realloc(ctx->containers, ctx->alloc_containers * sizeof(MD_CONTAINER));
+        new_containers = md_realloc(ctx, ctx->containers, ctx->alloc_containers * sizeof(MD_CONTAINER));
         if(new_containers == NULL) {
             MD_LOG("realloc() failed.");
             return -1;
@@ -6145,7 +6104,7 @@ md_analyze_line(MD_CTX* ctx, OFF beg, OFF* p_end,
 
         /* Check for start of raw HTML block. */
         if(off < ctx->size  &&  CH(off) == _T('<')
-            &&  !(ctx->parser.flags & MD_FLAG_NOHTMLBLOCKS))
+            &&  !(MD_FLAGS(ctx) & MD_FLAG_NOHTMLBLOCKS))
         {
             ctx->html_block_type = md_is_html_block_start_condition(ctx, off);
 
@@ -6167,7 +6126,7 @@ md_analyze_line(MD_CTX* ctx, OFF beg, OFF* p_end,
         }
 
         /* Check for table underline. */
-        if((ctx->parser.flags & MD_FLAG_TABLES)  &&  pivot_line->type == MD_LINE_TEXT
+        if((MD_FLAGS(ctx) & MD_FLAG_TABLES)  &&  pivot_line->type == MD_LINE_TEXT
             &&  off < ctx->size  &&  ISANYOF3(off, _T('|'), _T('-'), _T(':'))
             &&  n_parents == ctx->n_containers)
         {
@@ -6190,7 +6149,7 @@ md_analyze_line(MD_CTX* ctx, OFF beg, OFF* p_end,
         }
 
         /* Check for task mark. */
-        if((ctx->parser.flags & MD_FLAG_TASKLISTS)  &&  n_brothers + n_children > 0  &&
+        if((MD_FLAGS(ctx) & MD_FLAG_TASKLISTS)  &&  n_brothers + n_children > 0  &&
            ISANYOF_(ctx->containers[ctx->n_containers-1].ch, _T("-+*.)")))
         {
             OFF tmp = off;
@@ -6254,7 +6213,7 @@ md_analyze_line(MD_CTX* ctx, OFF beg, OFF* p_end,
             tmp--;
         while(tmp > line->beg && CH(tmp-1) == _T('#'))
             tmp--;
-        if(tmp == line->beg || ISBLANK(tmp-1) || (ctx->parser.flags & MD_FLAG_PERMISSIVEATXHEADERS))
+        if(tmp == line->beg || ISBLANK(tmp-1) || (MD_FLAGS(ctx) & MD_FLAG_PERMISSIVEATXHEADERS))
             line->end = tmp;
     }
 
@@ -6383,8 +6342,10 @@ abort:
     return ret;
 }
 
+/* Breaks the whole document into blocks, consuming all the link reference
+ * definitions on the way. */
 static int
-md_process_doc(MD_CTX *ctx)
+md_analyze_doc_blocks(MD_CTX *ctx)
 {
     const MD_LINE_ANALYSIS* pivot_line = &md_dummy_blank_line;
     MD_LINE_ANALYSIS line_buf[2];
@@ -6392,8 +6353,6 @@ md_process_doc(MD_CTX *ctx)
     OFF off = 0;
     int ret = 0;
 
-    MD_ENTER_BLOCK(MD_BLOCK_DOC, NULL);
-
     while(off < ctx->size) {
         if(line == pivot_line)
             line = (line == &line_buf[0] ? &line_buf[1] : &line_buf[0]);
@@ -6406,13 +6365,35 @@ md_process_doc(MD_CTX *ctx)
 
     MD_CHECK(md_build_ref_def_hashtable(ctx));
 
+abort:
+    return ret;
+}
+
+static int
+md_process_doc(MD_CTX *ctx)
+{
+    int ret = 0;
+
+    MD_ENTER_BLOCK(MD_BLOCK_DOC, NULL);
+
+    MD_TRACE_CHECK("md4c.analyze_blocks", md_analyze_doc_blocks(ctx));
+
     /* Process all blocks. */
     MD_CHECK(md_leave_child_containers(ctx, 0));
-    MD_CHECK(md_process_all_blocks(ctx));
+    MD_TRACE_CHECK("md4c.process_blocks", md_process_all_blocks(ctx));
 
     MD_LEAVE_BLOCK(MD_BLOCK_DOC, NULL);
 
 abort:
+    if(ctx->parser.stats != NULL) {
+        MD_PARSE_STATS* stats = ctx->parser.stats;
+        stats->alloc_block_bytes = (unsigned) ctx->alloc_block_bytes;
+        stats->alloc_container_bytes = (unsigned) (ctx->alloc_containers * sizeof(MD_CONTAINER));
+        stats->alloc_mark_bytes = (unsigned) (ctx->alloc_marks * sizeof(MD_MARK));
+        stats->alloc_buffer_bytes = (unsigned) (ctx->alloc_buffer * sizeof(MD_CHAR));
+        stats->ref_library_lookups = ctx->ref_library_lookups;
+        stats->ref_library_hits = ctx->ref_library_hits;
+    }
 
 #if 0
     /* Output some memory consumption statistics. */
@@ -6444,13 +6425,66 @@ abort:
  ***  Public API  ***
  ********************/
 
+static void
+md_setup_ctx(MD_CTX* ctx, const MD_CHAR* text, MD_SIZE size, const MD_PARSER* parser, void* userdata)
+{
+    int i;
+
+    memset(ctx, 0, sizeof(MD_CTX));
+    ctx->text = text;
+    ctx->size = size;
+    memcpy(&ctx->parser, parser, sizeof(MD_PARSER));
+    ctx->userdata = userdata;
+    ctx->code_indent_offset = (MD_FLAGS(ctx) & MD_FLAG_NOINDENTEDCODEBLOCKS) ? (OFF)(-1) : 4;
+    md_build_mark_char_map(ctx);
+    ctx->doc_ends_with_newline = (size > 0  &&  ISNEWLINE_(text[size-1]));
+    ctx->max_ref_def_output = MIN(MIN(16 * (uint64_t)size, (uint64_t)(1024 * 1024)), (uint64_t)SZ_MAX);
+    /* Enough for every library definition once, on top of what the
+     * document's size allows. */
+    if(parser->ref_library != NULL) {
+        ctx->max_ref_library_output = MIN((uint64_t)ctx->max_ref_def_output + 1 +
+                    parser->ref_library->def_output_size, (uint64_t)SZ_MAX);
+    }
+
+    /* Reset all mark stacks and lists. */
+    for(i = 0; i < (int) SIZEOF_ARRAY(ctx->opener_stacks); i++)
+        ctx->opener_stacks[i].top = -1;
+    ctx->unresolved_link_head = -1;
+    ctx->unresolved_link_tail = -1;
+    ctx->table_cell_boundaries_head = -1;
+    ctx->table_cell_boundaries_tail = -1;
+}
+
+static void
+md_cleanup_ctx(MD_CTX* ctx)
+{
+    md_free_ref_defs(ctx);
+    md_free_ref_def_hashtable(ctx);
+    md_free(ctx, ctx->buffer);
+    md_free(ctx, ctx->marks);
+    md_free(ctx, ctx->block_bytes);
+    md_free(ctx, ctx->containers);
+    md_arena_fini(ctx, &ctx->block_arena);
+    md_arena_fini(ctx, &ctx->doc_arena);
+}
+
+#ifdef MD4C_FIXED_FLAGS
+    #define MD_PARSE_FN     MD4C_FIXED_PARSE_FN
+#else
+    #define MD_PARSE_FN     md_parse_generic
+#endif
+
 int
-md_parse(const MD_CHAR* text, MD_SIZE size, const MD_PARSER* parser, void* userdata)
+MD_PARSE_FN(const MD_CHAR* text, MD_SIZE size, const MD_PARSER* parser, void* userdata)
 {
     MD_CTX ctx;
-    int i;
     int ret;
 
+#ifdef MD4C_FIXED_FLAGS
+    if(parser->flags != (unsigned) (MD4C_FIXED_FLAGS))
+        return md_parse_generic(text, size, parser, userdata);
+#endif
+
     if(parser->abi_version != 0) {
         if(parser->debug_log != NULL)
             parser->debug_log("Unsupported abi_version.", userdata);
@@ -6458,35 +6492,164 @@ md_parse(const MD_CHAR* text, MD_SIZE size, const MD_PARSER* parser, void* userd
     }
 
     /* Setup context structure. */
-    memset(&ctx, 0, sizeof(MD_CTX));
-    ctx.text = text;
-    ctx.size = size;
-    memcpy(&ctx.parser, parser, sizeof(MD_PARSER));
-    ctx.userdata = userdata;
-    ctx.code_indent_offset = (ctx.parser.flags & MD_FLAG_NOINDENTEDCODEBLOCKS) ? (OFF)(-1) : 4;
-    md_build_mark_char_map(&ctx);
-    ctx.doc_ends_with_newline = (size > 0  &&  ISNEWLINE_(text[size-1]));
-    ctx.max_ref_def_output = MIN(MIN(16 * (uint64_t)size, (uint64_t)(1024 * 1024)), (uint64_t)SZ_MAX);
-
-    /* Reset all mark stacks and lists. */
-    for(i = 0; i < (int) SIZEOF_ARRAY(ctx.opener_stacks); i++)
-        ctx.opener_stacks[i].top = -1;
-    ctx.ptr_stack.top = -1;
-    ctx.unresolved_link_head = -1;
-    ctx.unresolved_link_tail = -1;
-    ctx.table_cell_boundaries_head = -1;
-    ctx.table_cell_boundaries_tail = -1;
+    md_setup_ctx(&ctx, text, size, parser, userdata);
 
     /* All the work. */
     ret = md_process_doc(&ctx);
 
     /* Clean-up. */
-    md_free_ref_defs(&ctx);
-    md_free_ref_def_hashtable(&ctx);
-    free(ctx.buffer);
-    free(ctx.marks);
-    free(ctx.block_bytes);
-    free(ctx.containers);
+    md_cleanup_ctx(&ctx);
 
     return ret;
 }
+
+/* Everything below is only in the generic build. */
+#ifndef MD4C_FIXED_FLAGS
+
+int
+md_parse(const MD_CHAR* text, MD_SIZE size, const MD_PARSER* parser, void* userdata)
+{
+#ifdef MD4C_DIALECT_GODOT
+    /* Use a build specialized for the flags if there is one. */
+    if(parser->flags == (unsigned) (MD4C_DIALECT_GODOT_FLAGS))
+        return md_parse_godot_dialect(text, size, parser, userdata);
+#endif
+
+    return md_parse_generic(text, size, parser, userdata);
+}
+
+static int
+md_ref_library_block_callback(MD_BLOCKTYPE type, void* detail, void* userdata)
+{
+    return 0;
+}
+
+static int
+md_ref_library_span_callback(MD_SPANTYPE type, void* detail, void* userdata)
+{
+    return 0;
+}
+
+static int
+md_ref_library_text_callback(MD_TEXTTYPE type, const MD_CHAR* text, MD_SIZE size, void* userdata)
+{
+    return 0;
+}
+
+MD_REF_LIBRARY*
+md_ref_library_build(const MD_CHAR* text, MD_SIZE size, unsigned flags,
+                     const MD_ALLOCATOR* allocator)
+{
+    MD_PARSER parser;
+    MD_CTX ctx;
+    MD_REF_LIBRARY* library;
+    int i, j;
+    int ret;
+
+    /* md_malloc() needs just the allocator. */
+    memset(&ctx, 0, sizeof(MD_CTX));
+    ctx.parser.allocator = allocator;
+
+    library = (MD_REF_LIBRARY*) md_malloc(&ctx, sizeof(MD_REF_LIBRARY));
+    if(library == NULL)
+        return NULL;
+    memset(library, 0, sizeof(MD_REF_LIBRARY));
+    library->allocator = allocator;
+    library->text = (CHAR*) md_malloc(&ctx, (size > 0 ? size : 1) * sizeof(CHAR));
+    if(library->text == NULL) {
+        md_free(&ctx, library);
+        return NULL;
+    }
+    memcpy(library->text, text, size * sizeof(CHAR));
+
+    /* Only the block analysis runs, so the callbacks are never really
+     * called. They still must not be NULL. */
+    memset(&parser, 0, sizeof(MD_PARSER));
+    parser.flags = flags;
+    parser.enter_block = md_ref_library_block_callback;
+    parser.leave_block = md_ref_library_block_callback;
+    parser.enter_span = md_ref_library_span_callback;
+    parser.leave_span = md_ref_library_span_callback;
+    parser.text = md_ref_library_text_callback;
+    parser.allocator = allocator;
+
+    md_setup_ctx(&ctx, library->text, size, &parser, NULL);
+    ret = md_analyze_doc_blocks(&ctx);
+    if(ret != 0) {
+        md_cleanup_ctx(&ctx);
+        md_free(&ctx, library->text);
+        md_free(&ctx, library);
+        return NULL;
+    }
+
+    /* Take over the definitions. */
+    library->ref_defs = ctx.ref_defs;
+    library->n_ref_defs = ctx.n_ref_defs;
+    library->ref_def_hashtable = ctx.ref_def_hashtable;
+    library->ref_def_hashtable_size = ctx.ref_def_hashtable_size;
+    library->arena = ctx.doc_arena;
+    ctx.ref_defs = NULL;
+    ctx.n_ref_defs = 0;
+    ctx.ref_def_hashtable = NULL;
+    ctx.ref_def_hashtable_size = 0;
+    memset(&ctx.doc_arena, 0, sizeof(MD_ARENA));
+    md_cleanup_ctx(&ctx);
+
+    for(i = 0; i < library->n_ref_defs; i++) {
+        const MD_REF_DEF* def = &library->ref_defs[i];
+        library->def_output_size = MIN((uint64_t)library->def_output_size +
+                    def->label_size + def->title_size + def->dest_size, (uint64_t)SZ_MAX);
+    }
+
+    /* Count distinct labels. Duplicates in complex buckets all point to the
+     * first such definition. */
+    for(i = 0; i < library->ref_def_hashtable_size; i++) {
+        void* bucket = library->ref_def_hashtable[i];
+        MD_REF_DEF_LIST* list;
+
+        if(bucket == NULL)
+            continue;
+        if(library->ref_defs <= (MD_REF_DEF*) bucket  &&  (MD_REF_DEF*) bucket < library->ref_defs + library->n_ref_defs) {
+            library->n_labels++;
+            continue;
+        }
+
+        list = (MD_REF_DEF_LIST*) bucket;
+        for(j = 0; j < list->n_ref_defs; j++) {
+            if(j == 0  ||  list->ref_defs[j] != list->ref_defs[j-1])
+                library->n_labels++;
+        }
+    }
+
+    return library;
+}
+
+unsigned
+md_ref_library_size(const MD_REF_LIBRARY* library)
+{
+    return (library != NULL ? library->n_labels : 0);
+}
+
+void
+md_ref_library_free(MD_REF_LIBRARY* library)
+{
+    MD_CTX ctx;
+
+    if(library == NULL)
+        return;
+
+    /* Hand the tables back to a context so the usual clean-up applies. */
+    memset(&ctx, 0, sizeof(MD_CTX));
+    ctx.parser.allocator = library->allocator;
+    ctx.ref_defs = library->ref_defs;
+    ctx.n_ref_defs = library->n_ref_defs;
+    ctx.ref_def_hashtable = library->ref_def_hashtable;
+    ctx.ref_def_hashtable_size = library->ref_def_hashtable_size;
+    ctx.doc_arena = library->arena;
+    md_cleanup_ctx(&ctx);
+
+    md_free(&ctx, library->text);
+    md_free(&ctx, library);
+}
+
+#endif  /* #ifndef MD4C_FIXED_FLAGS */
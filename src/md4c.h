@@ -26,6 +26,8 @@
 #ifndef MD4C_H
 #define MD4C_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
     extern "C" {
 #endif
@@ -334,6 +336,42 @@ typedef struct MD_SPAN_WIKILINK {
 #define MD_DIALECT_COMMONMARK               0
 #define MD_DIALECT_GITHUB                   (MD_FLAG_PERMISSIVEAUTOLINKS | MD_FLAG_TABLES | MD_FLAG_STRIKETHROUGH | MD_FLAG_TASKLISTS)
 
+/* Memory allocation callbacks.
+ *
+ * When MD_PARSER::allocator is set, all memory the parser needs is requested
+ * through these instead of malloc(), realloc() and free(). All three must be
+ * provided. 'userdata' is MD_ALLOCATOR::userdata, not the one passed to
+ * md_parse().
+ */
+typedef struct MD_ALLOCATOR {
+    void* (*malloc_fn)(size_t /*size*/, void* /*userdata*/);
+    void* (*realloc_fn)(void* /*ptr*/, size_t /*size*/, void* /*userdata*/);
+    void (*free_fn)(void* /*ptr*/, void* /*userdata*/);
+    void* userdata;
+} MD_ALLOCATOR;
+
+/* Prebuilt, read-only set of link reference definitions.
+ * See md_ref_library_build().
+ */
+typedef struct MD_REF_LIBRARY MD_REF_LIBRARY;
+
+/* Statistics of one md_parse() call. See MD_PARSER::stats.
+ */
+typedef struct MD_PARSE_STATS {
+    /* Sizes of the internal buffers when parsing ended, which is their peak
+     * as they only grow during a parse. */
+    unsigned alloc_block_bytes;
+    unsigned alloc_container_bytes;
+    unsigned alloc_mark_bytes;
+    unsigned alloc_buffer_bytes;
+
+    /* Reference link labels which the document does not define itself and
+     * which were therefore looked up in MD_PARSER::ref_library, and how many
+     * of those the library resolved. */
+    unsigned ref_library_lookups;
+    unsigned ref_library_hits;
+} MD_PARSE_STATS;
+
 /* Parser structure.
  */
 typedef struct MD_PARSER {
@@ -380,6 +418,33 @@ typedef struct MD_PARSER {
     /* Reserved. Set to NULL.
      */
     void (*syntax)(void);
+
+    /* Memory allocation callbacks. Optional (may be NULL), in which case the
+     * C runtime's malloc(), realloc() and free() are used.
+     */
+    const MD_ALLOCATOR* allocator;
+
+    /* Link reference definitions shared by many documents. Optional (may be
+     * NULL). A reference link whose label the document does not define
+     * itself is looked up here. The library is only read, so one library can
+     * be used by any number of concurrent md_parse() calls.
+     */
+    const MD_REF_LIBRARY* ref_library;
+
+    /* Limits for untrusted input. Zero means unlimited. When one is hit,
+     * md_parse() stops and returns MD_LIMIT_EXCEEDED.
+     *
+     * max_nesting: Depth of nested container blocks (block quotes, lists).
+     * max_marks: Potential inline delimiters ('*', '[', '`', '<', '&', ...)
+     *            collected for a single paragraph or other leaf block.
+     */
+    unsigned max_nesting;
+    unsigned max_marks;
+
+    /* Optional (may be NULL). If set, it is filled in when md_parse()
+     * returns, whether or not the parse succeeded.
+     */
+    MD_PARSE_STATS* stats;
 } MD_PARSER;
 
 
@@ -394,12 +459,33 @@ typedef MD_PARSER MD_RENDERER;
  * to another format.
  *
  * Zero is returned on success. If a runtime error occurs (e.g. a memory
- * fails), -1 is returned. If the processing is aborted due any callback
- * returning non-zero, the return value of the callback is returned.
+ * fails), -1 is returned. If a limit in MD_PARSER is exceeded,
+ * MD_LIMIT_EXCEEDED is returned. If the processing is aborted due any
+ * callback returning non-zero, the return value of the callback is returned.
  */
+#define MD_LIMIT_EXCEEDED       (-2)
+
 int md_parse(const MD_CHAR* text, MD_SIZE size, const MD_PARSER* parser, void* userdata);
 
 
+/* Build a library from all the link reference definitions in 'text', e.g. a
+ * glossary of "[term]: url" lines. Anything else in the text is ignored.
+ * 'flags' are MD_FLAG_xxxx values, as for MD_PARSER::flags. The text is
+ * copied, so it does not have to outlive the library. 'allocator' may be
+ * NULL, otherwise it must outlive the library.
+ *
+ * Returns NULL if a memory allocation fails.
+ */
+MD_REF_LIBRARY* md_ref_library_build(const MD_CHAR* text, MD_SIZE size, unsigned flags,
+                                     const MD_ALLOCATOR* allocator);
+
+/* Number of distinct labels in the library. */
+unsigned md_ref_library_size(const MD_REF_LIBRARY* library);
+
+/* Free a library. It must not be used by any running md_parse() anymore. */
+void md_ref_library_free(MD_REF_LIBRARY* library);
+
+
 #ifdef __cplusplus
     }  /* extern "C" { */
 #endif
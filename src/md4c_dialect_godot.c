@@ -0,0 +1,20 @@
+/*
+ * md4c compiled for MD4C_DIALECT_GODOT_FLAGS only, see md4c_dialects.h.
+ * Empty unless MD4C_DIALECT_GODOT is defined.
+ */
+
+#ifdef MD4C_DIALECT_GODOT
+
+#include "md4c_dialects.h"
+
+#define MD4C_FIXED_FLAGS        MD4C_DIALECT_GODOT_FLAGS
+#define MD4C_FIXED_PARSE_FN     md_parse_godot_dialect
+
+#include "md4c.c"
+
+#else
+
+/* ISO C doesn't allow an empty translation unit. */
+typedef int md4c_dialect_godot_disabled;
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * Dialects md4c is additionally compiled for.
+ *
+ * md4c.c tests MD_PARSER::flags all over its hot loops. For each dialect
+ * listed here, a wrapper translation unit includes md4c.c again with
+ * MD4C_FIXED_FLAGS defined, so the flags become a compile-time constant and
+ * the code of disabled features is dropped. md_parse() dispatches to such
+ * a build once per call when MD_PARSER::flags matches exactly, and to the
+ * generic build otherwise.
+ *
+ * The specialized builds are only compiled in when MD4C_DIALECT_GODOT is
+ * defined, by `scons md_dialect=yes`. bench/bench_dialect.cpp measures
+ * whether that is worth it on a given compiler and machine.
+ */
+
+#ifndef MD4C_DIALECTS_H
+#define MD4C_DIALECTS_H
+
+#include "md4c.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/* The dialect of everything in this extension (MDRenderer::PARSER_FLAGS).
+ * Specialized in md4c_dialect_godot.c. */
+#define MD4C_DIALECT_GODOT_FLAGS    (MD_FLAG_TABLES | MD_FLAG_STRIKETHROUGH | MD_FLAG_WIKILINKS | \
+                                     MD_FLAG_UNDERLINE | MD_FLAG_NOHTMLBLOCKS | MD_FLAG_NOHTMLSPANS)
+
+/* Same as md_parse(), but always uses the build for any flags. */
+int md_parse_generic(const MD_CHAR* text, MD_SIZE size, const MD_PARSER* parser, void* userdata);
+
+/* Same as md_parse(), using the build specialized for MD4C_DIALECT_GODOT_FLAGS.
+ * Falls back to md_parse_generic() for any other flags. Only defined when
+ * MD4C_DIALECT_GODOT is. */
+int md_parse_godot_dialect(const MD_CHAR* text, MD_SIZE size, const MD_PARSER* parser, void* userdata);
+
+#ifdef __cplusplus
+    }  /* extern "C" { */
+#endif
+
+#endif  /* MD4C_DIALECTS_H */
@@ -0,0 +1,102 @@
+#include "md_batch.h"
+
+#include "md_bbcode_sink.h"
+
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/class_db.hpp>
+
+using namespace godot;
+
+void MDBatch::_bind_methods() {
+	ClassDB::bind_static_method("MDBatch", D_METHOD("convert_all", "markdowns", "format", "library"), &MDBatch::convert_all, DEFVAL(Ref<MD2BBFormat>()), DEFVAL(Ref<MDRefLibrary>()));
+	ClassDB::bind_method(D_METHOD("start", "markdowns", "format", "library"), &MDBatch::start, DEFVAL(Ref<MD2BBFormat>()), DEFVAL(Ref<MDRefLibrary>()));
+	ClassDB::bind_method(D_METHOD("is_done"), &MDBatch::is_done);
+	ClassDB::bind_method(D_METHOD("get_progress"), &MDBatch::get_progress);
+	ClassDB::bind_method(D_METHOD("get_failed_count"), &MDBatch::get_failed_count);
+	ClassDB::bind_method(D_METHOD("wait"), &MDBatch::wait);
+}
+
+MDBatch::~MDBatch() {
+	// Workers hold a raw pointer to this batch, so they must finish before it goes away
+	wait();
+}
+
+/**
+ * Convert every document to BBCode, blocking until all are done. Results are in input order.
+ */
+PackedStringArray MDBatch::convert_all(const PackedStringArray& markdowns, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library) {
+	Ref<MDBatch> batch;
+	batch.instantiate();
+	batch->start(markdowns, format, library);
+	return batch->wait();
+}
+
+/**
+ * Start converting in the background. The format is read once here, so it may be edited while the batch runs.
+ * The library is shared read-only by all the workers.
+ */
+Error MDBatch::start(const PackedStringArray& markdowns, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library) {
+	ERR_FAIL_COND_V_MSG(_group_id >= 0, ERR_BUSY, "[MDBatch] A batch is already running. Call wait() first.");
+
+	_style = MDRenderStyle();
+	if (format.is_valid())
+		format->get_render_style(_style);
+	_ref_library = library;
+	_ref_library_table = library.is_valid() ? library->get_library() : nullptr;
+	_sources = markdowns;
+	_results.resize(markdowns.size());
+	_results_ptr = _results.ptrw();
+	_completed.store(0);
+	_failed.store(0);
+	if (markdowns.size() == 0)
+		return OK;
+
+	_group_id = WorkerThreadPool::get_singleton()->add_group_task(callable_mp(this, &MDBatch::_convert_one), markdowns.size(), -1, false, "MDBatch conversion");
+	return OK;
+}
+
+bool MDBatch::is_done() const {
+	return _completed.load() == (uint32_t)_sources.size();
+}
+
+float MDBatch::get_progress() const {
+	if (_sources.size() == 0)
+		return 1.0f;
+	return (float)_completed.load() / (float)_sources.size();
+}
+
+int MDBatch::get_failed_count() const {
+	return (int)_failed.load();
+}
+
+/**
+ * Block until the batch is finished and return its BBCode. Documents that failed to convert are empty.
+ */
+PackedStringArray MDBatch::wait() {
+	if (_group_id >= 0) {
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(_group_id);
+		_group_id = -1;
+	}
+	_results_ptr = nullptr;
+	return _results;
+}
+
+/**
+ * Runs on a worker thread. The sink belongs to this task: its buffer is reserved at about the size of the output,
+ * so is allocated once, and is freed when the task ends instead of staying with the worker thread.
+ * md4c allocates a fresh parser context per call.
+ */
+void MDBatch::_convert_one(uint32_t index) {
+	MDBBCodeSink sink(&MD_GODOT_ALLOCATOR);
+	CharString md_utf8 = _sources[index].utf8();
+	sink.output.reserve(md_utf8.length() + md_utf8.length() / 2 + 64);
+	MDTypedRenderer<MDBBCodeSink> renderer(_style, sink, &MD_GODOT_ALLOCATOR);
+	renderer.set_ref_library(_ref_library_table);
+	int err = renderer.render(md_utf8.get_data(), md_utf8.length());
+	if (err == MD_OK) {
+		_results_ptr[index] = String::utf8(sink.output.get_data(), sink.output.size());
+	} else {
+		_failed.fetch_add(1);
+	}
+	_completed.fetch_add(1);
+}
@@ -0,0 +1,51 @@
+#ifndef MD_BATCH_H
+#define MD_BATCH_H
+
+#include "md_text_label.h"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+
+#include <atomic>
+
+namespace godot {
+
+/**
+ * Converts many markdown documents to BBCode in parallel on the WorkerThreadPool.
+ * Either call the blocking MDBatch.convert_all(), or start() a batch and poll get_progress() before wait().
+ */
+class MDBatch : public RefCounted {
+	GDCLASS(MDBatch, RefCounted)
+
+private:
+	PackedStringArray _sources;
+	PackedStringArray _results;
+	// Raw pointer into _results. Workers write disjoint elements, so no locking is needed
+	String* _results_ptr = nullptr;
+	MDRenderStyle _style;
+	// Kept referenced while workers read _ref_library_table
+	Ref<MDRefLibrary> _ref_library;
+	const MD_REF_LIBRARY* _ref_library_table = nullptr;
+	int64_t _group_id = -1;
+	std::atomic<uint32_t> _completed{ 0 };
+	std::atomic<uint32_t> _failed{ 0 };
+
+	void _convert_one(uint32_t index);
+
+protected:
+	static void _bind_methods();
+
+public:
+	static PackedStringArray convert_all(const PackedStringArray& markdowns, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library);
+
+	Error start(const PackedStringArray& markdowns, const Ref<MD2BBFormat>& format, const Ref<MDRefLibrary>& library);
+	bool is_done() const;
+	float get_progress() const;
+	int get_failed_count() const;
+	PackedStringArray wait();
+
+	~MDBatch();
+};
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "md_bbcode_sink.h"
+
+#include "md_renderer_impl.h"
+
+template class MDTypedRenderer<MDBBCodeSink>;
+
+void MDBBCodeSink::clear() {
+	output.clear();
+	_tags.clear();
+	_cell_style = MDCellStyle();
+}
+
+void MDBBCodeSink::_push_tag(const char* tag) {
+	output.append_char('[');
+	output.append(tag);
+	output.append_char(']');
+	_tags.push_back(tag);
+}
+
+void MDBBCodeSink::push_font_size(float size) {
+	output.append("[font_size=");
+	output.append_int((int)size);
+	output.append_char(']');
+	_tags.push_back("font_size");
+}
+
+void MDBBCodeSink::push_bold() {
+	_push_tag("b");
+}
+
+void MDBBCodeSink::push_italics() {
+	_push_tag("i");
+}
+
+void MDBBCodeSink::push_underline() {
+	_push_tag("u");
+}
+
+void MDBBCodeSink::push_strikethrough() {
+	_push_tag("s");
+}
+
+void MDBBCodeSink::push_mono() {
+	_push_tag("code");
+}
+
+void MDBBCodeSink::push_color(const MDColor& color) {
+	output.append("[color=");
+	_append_color(color);
+	output.append_char(']');
+	_tags.push_back("color");
+}
+
+void MDBBCodeSink::push_paragraph() {
+	_push_tag("p");
+}
+
+void MDBBCodeSink::push_list(bool ordered, MD_CHAR mark) {
+	if (ordered) {
+		output.append("[ol type=1]");
+		_tags.push_back("ol");
+	} else {
+		output.append("[ul bullet=");
+		output.append_char(mark);
+		output.append_char(']');
+		_tags.push_back("ul");
+	}
+}
+
+void MDBBCodeSink::push_table(int columns) {
+	output.append("[table=");
+	output.append_int(columns);
+	output.append_char(']');
+	_tags.push_back("table");
+}
+
+void MDBBCodeSink::set_cell_style(const MDCellStyle& style) {
+	// BBCode has no equivalent of the cell size override, so only colors and padding are kept
+	_cell_style = style;
+}
+
+void MDBBCodeSink::push_cell() {
+	output.append("[cell border=");
+	_append_color(_cell_style.border_color);
+	output.append(" bg=");
+	_append_color(_cell_style.row_bg_odd);
+	output.append_char(',');
+	_append_color(_cell_style.row_bg_even);
+	output.append(" padding=");
+	for (int i = 0; i < 4; i++) {
+		if (i > 0)
+			output.append_char(',');
+		output.append_int((int)_cell_style.padding[i]);
+	}
+	output.append_char(']');
+	_tags.push_back("cell");
+}
+
+void MDBBCodeSink::pop() {
+	if (_tags.empty())
+		return;
+	output.append("[/");
+	output.append(_tags.back());
+	output.append_char(']');
+	_tags.pop_back();
+}
+
+void MDBBCodeSink::add_text(const MD_CHAR* text, MD_SIZE size) {
+	_append_escaped(text, size);
+}
+
+void MDBBCodeSink::add_image(const MD_CHAR* src, MD_SIZE size) {
+	output.append("[img]");
+	_append_escaped(src, size);
+	output.append("[/img]");
+}
+
+/**
+ * Square brackets in text would otherwise be parsed as tags
+ */
+void MDBBCodeSink::_append_escaped(const MD_CHAR* text, MD_SIZE size) {
+	MD_SIZE run_start = 0;
+	for (MD_SIZE i = 0; i < size; i++) {
+		if (text[i] != '[' && text[i] != ']')
+			continue;
+		output.append(text + run_start, i - run_start);
+		output.append(text[i] == '[' ? "[lb]" : "[rb]", 4);
+		run_start = i + 1;
+	}
+	output.append(text + run_start, size - run_start);
+}
+
+void MDBBCodeSink::_append_color(const MDColor& color) {
+	static const char HEX[] = "0123456789abcdef";
+	const float channels[4] = { color.r, color.g, color.b, color.a };
+	output.append_char('#');
+	for (int i = 0; i < 4; i++) {
+		float clamped = channels[i] < 0.0f ? 0.0f : (channels[i] > 1.0f ? 1.0f : channels[i]);
+		int byte = (int)(clamped * 255.0f + 0.5f);
+		output.append_char(HEX[byte >> 4]);
+		output.append_char(HEX[byte & 0xF]);
+	}
+}
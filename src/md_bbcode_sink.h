@@ -0,0 +1,54 @@
+#ifndef MD_BBCODE_SINK_H
+#define MD_BBCODE_SINK_H
+
+#include "md_renderer.h"
+#include "md_string_builder.h"
+
+#include <vector>
+
+/**
+ * Writes the tag stack as a BBCode string, as accepted by RichTextLabel.text with bbcode_enabled
+ */
+class MDBBCodeSink final : public MDRenderSink {
+public:
+	MDStringBuilder output;
+
+	// allocator is used for output and may be null to use the C runtime
+	explicit MDBBCodeSink(const MD_ALLOCATOR* allocator = nullptr) :
+			output(allocator) {}
+
+	// Reset for another document, keeping the output buffer's capacity
+	void clear();
+
+	void push_font_size(float size) override;
+	void push_bold() override;
+	void push_italics() override;
+	void push_underline() override;
+	void push_strikethrough() override;
+	void push_mono() override;
+	void push_color(const MDColor& color) override;
+	void push_paragraph() override;
+	void push_list(bool ordered, MD_CHAR mark) override;
+	void push_table(int columns) override;
+	void set_cell_style(const MDCellStyle& style) override;
+	void push_cell() override;
+	void pop() override;
+
+	void add_text(const MD_CHAR* text, MD_SIZE size) override;
+	void add_image(const MD_CHAR* src, MD_SIZE size) override;
+	bool failed() const override { return output.failed(); }
+
+private:
+	// Names of the open tags, all string literals
+	std::vector<const char*> _tags;
+	MDCellStyle _cell_style;
+
+	void _push_tag(const char* tag);
+	void _append_escaped(const MD_CHAR* text, MD_SIZE size);
+	void _append_color(const MDColor& color);
+};
+
+// Calls the sink directly instead of through MDRenderSink. Instantiated in md_bbcode_sink.cpp
+extern template class MDTypedRenderer<MDBBCodeSink>;
+
+#endif
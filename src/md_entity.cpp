@@ -0,0 +1,87 @@
+#include "md_entity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gen/md_entity.gen.h"
+
+int md_encode_utf8(unsigned codepoint, MD_CHAR* r_utf8) {
+	// Surrogates and out of range values aren't valid scalar values
+	if ((codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF)
+		codepoint = 0xFFFD;
+	if (codepoint < 0x80) {
+		r_utf8[0] = (MD_CHAR)codepoint;
+		return 1;
+	}
+	if (codepoint < 0x800) {
+		r_utf8[0] = (MD_CHAR)(0xC0 | (codepoint >> 6));
+		r_utf8[1] = (MD_CHAR)(0x80 | (codepoint & 0x3F));
+		return 2;
+	}
+	if (codepoint < 0x10000) {
+		r_utf8[0] = (MD_CHAR)(0xE0 | (codepoint >> 12));
+		r_utf8[1] = (MD_CHAR)(0x80 | ((codepoint >> 6) & 0x3F));
+		r_utf8[2] = (MD_CHAR)(0x80 | (codepoint & 0x3F));
+		return 3;
+	}
+	r_utf8[0] = (MD_CHAR)(0xF0 | (codepoint >> 18));
+	r_utf8[1] = (MD_CHAR)(0x80 | ((codepoint >> 12) & 0x3F));
+	r_utf8[2] = (MD_CHAR)(0x80 | ((codepoint >> 6) & 0x3F));
+	r_utf8[3] = (MD_CHAR)(0x80 | (codepoint & 0x3F));
+	return 4;
+}
+
+static int _decode_numeric_entity(const MD_CHAR* digits, MD_SIZE size, MD_CHAR* r_utf8) {
+	unsigned codepoint = 0;
+	if (size > 0 && (digits[0] == 'x' || digits[0] == 'X')) {
+		for (MD_SIZE i = 1; i < size; i++) {
+			MD_CHAR c = digits[i];
+			unsigned digit = (c >= '0' && c <= '9') ? (unsigned)(c - '0') : (unsigned)((c | 0x20) - 'a' + 10);
+			codepoint = codepoint * 16 + digit;
+			if (codepoint > 0x10FFFF)
+				break;
+		}
+	} else {
+		for (MD_SIZE i = 0; i < size; i++) {
+			codepoint = codepoint * 10 + (unsigned)(digits[i] - '0');
+			if (codepoint > 0x10FFFF)
+				break;
+		}
+	}
+	// CommonMark replaces U+0000 with U+FFFD
+	if (codepoint == 0)
+		codepoint = 0xFFFD;
+	return md_encode_utf8(codepoint, r_utf8);
+}
+
+// 32-bit FNV-1a with a seed folded into the offset basis, the same as scripts/build_entity_table.py
+static inline uint32_t _entity_hash(uint32_t seed, const MD_CHAR* name, MD_SIZE size) {
+	uint32_t hash = 2166136261u ^ seed;
+	for (MD_SIZE i = 0; i < size; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+int md_decode_entity(const MD_CHAR* entity, MD_SIZE size, MD_CHAR* r_utf8) {
+	// md4c only reports syntactically valid entities, so the '&' and ';' are always there
+	if (size < 3 || entity[0] != '&' || entity[size - 1] != ';')
+		return 0;
+	if (entity[1] == '#')
+		return _decode_numeric_entity(entity + 2, size - 3, r_utf8);
+
+	// Every HTML5 name hashes to a distinct entry, so a single comparison tells whether this is one of them
+	const MD_CHAR* name = entity + 1;
+	MD_SIZE name_size = size - 2;
+	if (name_size > MD_ENTITY_MAX_NAME)
+		return 0;
+	uint32_t seed = MD_ENTITY_SEEDS[_entity_hash(0, name, name_size) % MD_ENTITY_BUCKETS];
+	const MDEntityEntry& named = MD_ENTITIES[_entity_hash(seed, name, name_size) % MD_ENTITY_COUNT];
+	if (named.name_size != name_size || memcmp(MD_ENTITY_NAMES + named.name_offset, name, name_size) != 0)
+		return 0;
+	int written = md_encode_utf8(named.codepoint, r_utf8);
+	if (named.second_codepoint != 0)
+		written += md_encode_utf8(named.second_codepoint, r_utf8 + written);
+	return written;
+}
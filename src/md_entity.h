@@ -0,0 +1,18 @@
+#ifndef MD_ENTITY_H
+#define MD_ENTITY_H
+
+#include "md4c.h"
+
+// Longest UTF-8 expansion of a single entity
+#define MD_ENTITY_MAX_UTF8 8
+
+/**
+ * Decode a MD_TEXT_ENTITY run ("&amp;", "&#123;", "&#x1F600;") to UTF-8.
+ * Writes at most MD_ENTITY_MAX_UTF8 bytes to r_utf8 and returns the count, or 0 if the entity is unknown.
+ */
+int md_decode_entity(const MD_CHAR* entity, MD_SIZE size, MD_CHAR* r_utf8);
+
+// Encode a code point as UTF-8, returns the number of bytes written (1-4)
+int md_encode_utf8(unsigned codepoint, MD_CHAR* r_utf8);
+
+#endif
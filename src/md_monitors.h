@@ -0,0 +1,56 @@
+#ifndef MD_MONITORS_H
+#define MD_MONITORS_H
+
+#include "md4c.h"
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * Process-wide counters behind the "Markdown/..." Performance monitors, registered in register_types.cpp.
+ * Relaxed atomics, so they can be updated from any thread, e.g. MDBatch workers, and stay enabled in release builds.
+ * Free of godot-cpp like the renderer that updates them.
+ */
+struct MDMonitors {
+	// Running totals, shown by the monitors as a per-frame average
+
+	// Wall time of every render, whatever the sink, including md4c's parse
+	static inline std::atomic<uint64_t> parse_usec{ 0 };
+	// Wall time of MDTextLabel updates, i.e. the render plus committing its items to the RichTextLabel
+	static inline std::atomic<uint64_t> label_usec{ 0 };
+	static inline std::atomic<uint64_t> parsed_bytes{ 0 };
+	// RichTextLabel items pushed by MDTextLabel
+	static inline std::atomic<uint64_t> label_items{ 0 };
+	static inline std::atomic<uint64_t> ref_library_lookups{ 0 };
+	static inline std::atomic<uint64_t> ref_library_hits{ 0 };
+
+	static inline std::atomic<int64_t> live_labels{ 0 };
+
+	// Largest md4c buffers of any parse since the monitor last took them, at most once per frame
+	static inline std::atomic<uint32_t> peak_block_bytes{ 0 };
+	static inline std::atomic<uint32_t> peak_container_bytes{ 0 };
+	static inline std::atomic<uint32_t> peak_mark_bytes{ 0 };
+	static inline std::atomic<uint32_t> peak_buffer_bytes{ 0 };
+
+	static void record_parse(uint64_t usec, uint64_t bytes, const MD_PARSE_STATS& stats) {
+		parse_usec.fetch_add(usec, std::memory_order_relaxed);
+		parsed_bytes.fetch_add(bytes, std::memory_order_relaxed);
+		if (stats.ref_library_lookups > 0) {
+			ref_library_lookups.fetch_add(stats.ref_library_lookups, std::memory_order_relaxed);
+			ref_library_hits.fetch_add(stats.ref_library_hits, std::memory_order_relaxed);
+		}
+		raise_peak(peak_block_bytes, stats.alloc_block_bytes);
+		raise_peak(peak_container_bytes, stats.alloc_container_bytes);
+		raise_peak(peak_mark_bytes, stats.alloc_mark_bytes);
+		raise_peak(peak_buffer_bytes, stats.alloc_buffer_bytes);
+	}
+
+	static void raise_peak(std::atomic<uint32_t>& peak, uint32_t value) {
+		uint32_t current = peak.load(std::memory_order_relaxed);
+		// Usually not a new peak, so this rarely writes at all
+		while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "md_plain_text.h"
+
+#include "md_entity.h"
+#include "md_monitors.h"
+#include "md_trace.h"
+
+#include <chrono>
+
+const MD_PARSER MDPlainTextRenderer::_parser = {
+	0,
+	MDRenderer::PARSER_FLAGS,
+	&MDPlainTextRenderer::_enter_block,
+	&MDPlainTextRenderer::_leave_block,
+	&MDPlainTextRenderer::_enter_span,
+	&MDPlainTextRenderer::_leave_span,
+	&MDPlainTextRenderer::_text,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	0,
+	0,
+	nullptr
+};
+
+MDPlainTextRenderer::MDPlainTextRenderer(MDStringBuilder& output, const MD_ALLOCATOR* allocator) :
+		_output(output), _allocator(allocator) {
+}
+
+int MDPlainTextRenderer::render(const MD_CHAR* text, MD_SIZE size) {
+	// Plain text is almost never longer than its markdown, so one allocation is usually enough
+	_output.reserve(_output.size() + size + 16);
+	_cell_index = 0;
+	MD_PARSE_STATS stats = {};
+	MD_PARSER parser = _parser;
+	parser.allocator = _allocator;
+	parser.ref_library = _ref_library;
+	parser.stats = &stats;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	MD_TRACE_BEGIN("MDPlainTextRenderer.render");
+	int err = md_parse(text, size, &parser, this);
+	MD_TRACE_END();
+	if (err == MD_OK && _output.failed())
+		err = OUT_OF_MEMORY;
+	std::chrono::microseconds elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	MDMonitors::record_parse((uint64_t)elapsed.count(), size, stats);
+	return err;
+}
+
+void MDPlainTextRenderer::_end_line() {
+	size_t size = _output.size();
+	if (size > 0 && _output.get_data()[size - 1] != '\n')
+		_output.append_char('\n');
+}
+
+int MDPlainTextRenderer::_enter_block(MD_BLOCKTYPE block_type, void* detail, void* user_data) {
+	MDPlainTextRenderer* renderer = (MDPlainTextRenderer*)user_data;
+	switch (block_type) {
+		case MD_BLOCK_TR:
+			renderer->_cell_index = 0;
+			break;
+		case MD_BLOCK_TH:
+		case MD_BLOCK_TD:
+			if (renderer->_cell_index++ > 0)
+				renderer->_output.append_char('\t');
+			break;
+		default:
+			break;
+	}
+	return 0;
+}
+
+int MDPlainTextRenderer::_leave_block(MD_BLOCKTYPE block_type, void* detail, void* user_data) {
+	MDPlainTextRenderer* renderer = (MDPlainTextRenderer*)user_data;
+	switch (block_type) {
+		case MD_BLOCK_P:
+		case MD_BLOCK_H:
+		case MD_BLOCK_CODE:
+		case MD_BLOCK_HTML:
+		case MD_BLOCK_LI:
+		case MD_BLOCK_TR:
+			renderer->_end_line();
+			break;
+		default:
+			break;
+	}
+	return 0;
+}
+
+int MDPlainTextRenderer::_enter_span(MD_SPANTYPE span_type, void* detail, void* user_data) {
+	return 0;
+}
+
+int MDPlainTextRenderer::_leave_span(MD_SPANTYPE span_type, void* detail, void* user_data) {
+	return 0;
+}
+
+int MDPlainTextRenderer::_text(MD_TEXTTYPE text_type, const MD_CHAR* text, MD_SIZE size, void* user_data) {
+	MDStringBuilder& output = ((MDPlainTextRenderer*)user_data)->_output;
+	switch (text_type) {
+		case MD_TEXT_NORMAL:
+		case MD_TEXT_CODE:
+		case MD_TEXT_LATEXMATH:
+			output.append(text, size);
+			break;
+		case MD_TEXT_ENTITY:
+			{
+				MD_CHAR decoded[MD_ENTITY_MAX_UTF8];
+				int decoded_size = md_decode_entity(text, size, decoded);
+				if (decoded_size > 0) {
+					output.append(decoded, decoded_size);
+				} else {
+					output.append(text, size);
+				}
+			}
+			break;
+		case MD_TEXT_NULLCHAR:
+			// U+FFFD replacement character
+			output.append("\xEF\xBF\xBD", 3);
+			break;
+		case MD_TEXT_BR:
+			output.append_char('\n');
+			break;
+		case MD_TEXT_SOFTBR:
+			output.append_char(' ');
+			break;
+		default:
+			// Raw HTML is not readable text
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef MD_PLAIN_TEXT_H
+#define MD_PLAIN_TEXT_H
+
+#include "md_bbcode_sink.h"
+
+/**
+ * Extracts the readable text of a document, for text-to-speech, screen readers and length budgets.
+ * Styling is dropped, soft breaks become spaces, entities are decoded, blocks end in a newline and
+ * table cells are separated by tabs.
+ *
+ * Uses md4c callbacks directly instead of a MDRenderSink, so it runs close to raw parser speed.
+ * Holds no global state, so it can be used from any thread.
+ */
+class MDPlainTextRenderer {
+public:
+	// allocator may be null to use the C runtime
+	MDPlainTextRenderer(MDStringBuilder& output, const MD_ALLOCATOR* allocator = nullptr);
+
+	// Optional shared link reference definitions, used for labels the document doesn't define itself
+	void set_ref_library(const MD_REF_LIBRARY* library) { _ref_library = library; }
+
+	// Output is appended to, after reserving room for the whole document. Returns OUT_OF_MEMORY when output
+	// couldn't grow
+	int render(const MD_CHAR* text, MD_SIZE size);
+
+private:
+	MDStringBuilder& _output;
+	const MD_ALLOCATOR* _allocator;
+	const MD_REF_LIBRARY* _ref_library = nullptr;
+	int _cell_index = 0;
+
+	static const MD_PARSER _parser;
+
+	void _end_line();
+
+	static int _enter_block(MD_BLOCKTYPE block_type, void* detail, void* user_data);
+	static int _leave_block(MD_BLOCKTYPE block_type, void* detail, void* user_data);
+	static int _enter_span(MD_SPANTYPE span_type, void* detail, void* user_data);
+	static int _leave_span(MD_SPANTYPE span_type, void* detail, void* user_data);
+	static int _text(MD_TEXTTYPE text_type, const MD_CHAR* text, MD_SIZE size, void* user_data);
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "md_recording_sink.h"
+
+#include "md_renderer_impl.h"
+
+#include <string.h>
+
+template class MDTypedRenderer<MDRecordingSink>;
+
+void MDRecordingSink::clear() {
+	commands.clear();
+	text.clear();
+	colors.clear();
+	cell_styles.clear();
+	source_size = 0;
+	_source = nullptr;
+}
+
+void MDRecordingSink::begin_document(const MD_CHAR* text, MD_SIZE size) {
+	_source = text;
+	source_size = size;
+}
+
+void MDRecordingSink::push_font_size(float size) {
+	uint32_t bits;
+	memcpy(&bits, &size, sizeof(bits));
+	_add(MD_OP_PUSH_FONT_SIZE, bits);
+}
+
+void MDRecordingSink::push_color(const MDColor& color) {
+	_add(MD_OP_PUSH_COLOR, (uint32_t)colors.size());
+	colors.push_back(color);
+}
+
+void MDRecordingSink::set_cell_style(const MDCellStyle& style) {
+	_add(MD_OP_SET_CELL_STYLE, (uint32_t)cell_styles.size());
+	cell_styles.push_back(style);
+}
+
+void MDRecordingSink::_add_text(MDRenderOp op, const MD_CHAR* data, MD_SIZE size) {
+	_add(op, (uint32_t)text.size(), (uint32_t)size);
+	text.insert(text.end(), data, data + size);
+}
+
+/**
+ * Recorded as an offset from the start of the document, so it can be replayed against any copy of it.
+ * Text md4c built in its own buffers is not part of the document and is left out.
+ */
+void MDRecordingSink::track_source(const MD_CHAR* text, MD_SIZE size) {
+	if (_source == nullptr || text < _source || text + size > _source + source_size)
+		return;
+	_add(MD_OP_SOURCE, (uint32_t)(text - _source), (uint32_t)size);
+}
+
+/**
+ * Send every recorded call to another sink, in order.
+ * Text pointers passed on point into this recording, not the original document.
+ * Source ranges are only replayed if source, the document the recording was made from, is given.
+ */
+void MDRecordingSink::replay(MDRenderSink& sink, const MD_CHAR* source) const {
+	if (source != nullptr)
+		sink.begin_document(source, source_size);
+	for (const MDRenderCommand& command : commands) {
+		switch (command.op) {
+			case MD_OP_ENTER_BLOCK:
+				sink.enter_block((MD_BLOCKTYPE)command.a);
+				break;
+			case MD_OP_LEAVE_BLOCK:
+				sink.leave_block((MD_BLOCKTYPE)command.a);
+				break;
+			case MD_OP_PUSH_FONT_SIZE:
+				{
+					float size;
+					memcpy(&size, &command.a, sizeof(size));
+					sink.push_font_size(size);
+				}
+				break;
+			case MD_OP_PUSH_BOLD:
+				sink.push_bold();
+				break;
+			case MD_OP_PUSH_ITALICS:
+				sink.push_italics();
+				break;
+			case MD_OP_PUSH_UNDERLINE:
+				sink.push_underline();
+				break;
+			case MD_OP_PUSH_STRIKETHROUGH:
+				sink.push_strikethrough();
+				break;
+			case MD_OP_PUSH_MONO:
+				sink.push_mono();
+				break;
+			case MD_OP_PUSH_COLOR:
+				sink.push_color(colors[command.a]);
+				break;
+			case MD_OP_PUSH_PARAGRAPH:
+				sink.push_paragraph();
+				break;
+			case MD_OP_PUSH_LIST:
+				sink.push_list(command.a != 0, (MD_CHAR)command.b);
+				break;
+			case MD_OP_PUSH_TABLE:
+				sink.push_table((int)command.a);
+				break;
+			case MD_OP_SET_CELL_STYLE:
+				sink.set_cell_style(cell_styles[command.a]);
+				break;
+			case MD_OP_PUSH_CELL:
+				sink.push_cell();
+				break;
+			case MD_OP_POP:
+				sink.pop();
+				break;
+			case MD_OP_TEXT:
+				sink.add_text(text.data() + command.a, command.b);
+				break;
+			case MD_OP_IMAGE:
+				sink.add_image(text.data() + command.a, command.b);
+				break;
+			case MD_OP_SOURCE:
+				if (source != nullptr)
+					sink.track_source(source + command.a, command.b);
+				break;
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#ifndef MD_RECORDING_SINK_H
+#define MD_RECORDING_SINK_H
+
+#include "md_renderer.h"
+
+#include <stdint.h>
+#include <vector>
+
+enum MDRenderOp : uint8_t {
+	MD_OP_ENTER_BLOCK,
+	MD_OP_LEAVE_BLOCK,
+	MD_OP_PUSH_FONT_SIZE,
+	MD_OP_PUSH_BOLD,
+	MD_OP_PUSH_ITALICS,
+	MD_OP_PUSH_UNDERLINE,
+	MD_OP_PUSH_STRIKETHROUGH,
+	MD_OP_PUSH_MONO,
+	MD_OP_PUSH_COLOR,
+	MD_OP_PUSH_PARAGRAPH,
+	MD_OP_PUSH_LIST,
+	MD_OP_PUSH_TABLE,
+	MD_OP_SET_CELL_STYLE,
+	MD_OP_PUSH_CELL,
+	MD_OP_POP,
+	MD_OP_TEXT,
+	MD_OP_IMAGE,
+	MD_OP_SOURCE,
+};
+
+/**
+ * One recorded sink call. Meaning of the arguments depends on the op:
+ * block type, font size bits, index into colors/cell_styles, list ordered + mark, column count,
+ * offset + size into the text buffer, or offset + size into the source document.
+ */
+struct MDRenderCommand {
+	MDRenderOp op;
+	uint32_t a;
+	uint32_t b;
+};
+
+/**
+ * Records the output of MDRenderer as a flat opcode stream, so parsing can be done headless
+ * (or on another thread) and the result replayed onto any other sink later.
+ */
+class MDRecordingSink final : public MDRenderSink {
+public:
+	std::vector<MDRenderCommand> commands;
+	// All text and image sources, back to back
+	std::vector<MD_CHAR> text;
+	std::vector<MDColor> colors;
+	std::vector<MDCellStyle> cell_styles;
+	// Size of the document the recording was made from, which source ranges are offsets into
+	MD_SIZE source_size = 0;
+
+	void clear();
+	void replay(MDRenderSink& sink, const MD_CHAR* source = nullptr) const;
+
+	void begin_document(const MD_CHAR* text, MD_SIZE size) override;
+	void enter_block(MD_BLOCKTYPE block_type) override { _add(MD_OP_ENTER_BLOCK, (uint32_t)block_type); }
+	void leave_block(MD_BLOCKTYPE block_type) override { _add(MD_OP_LEAVE_BLOCK, (uint32_t)block_type); }
+
+	void push_font_size(float size) override;
+	void push_bold() override { _add(MD_OP_PUSH_BOLD); }
+	void push_italics() override { _add(MD_OP_PUSH_ITALICS); }
+	void push_underline() override { _add(MD_OP_PUSH_UNDERLINE); }
+	void push_strikethrough() override { _add(MD_OP_PUSH_STRIKETHROUGH); }
+	void push_mono() override { _add(MD_OP_PUSH_MONO); }
+	void push_color(const MDColor& color) override;
+	void push_paragraph() override { _add(MD_OP_PUSH_PARAGRAPH); }
+	void push_list(bool ordered, MD_CHAR mark) override { _add(MD_OP_PUSH_LIST, ordered ? 1 : 0, (uint32_t)(unsigned char)mark); }
+	void push_table(int columns) override { _add(MD_OP_PUSH_TABLE, (uint32_t)columns); }
+	void set_cell_style(const MDCellStyle& style) override;
+	void push_cell() override { _add(MD_OP_PUSH_CELL); }
+	void pop() override { _add(MD_OP_POP); }
+
+	void add_text(const MD_CHAR* text, MD_SIZE size) override { _add_text(MD_OP_TEXT, text, size); }
+	void add_image(const MD_CHAR* src, MD_SIZE size) override { _add_text(MD_OP_IMAGE, src, size); }
+	void track_source(const MD_CHAR* text, MD_SIZE size) override;
+
+private:
+	// Document being recorded, only valid during the render
+	const MD_CHAR* _source = nullptr;
+
+	void _add(MDRenderOp op, uint32_t a = 0, uint32_t b = 0) { commands.push_back({ op, a, b }); }
+	void _add_text(MDRenderOp op, const MD_CHAR* data, MD_SIZE size);
+};
+
+// Calls the sink directly instead of through MDRenderSink. Instantiated in md_recording_sink.cpp
+extern template class MDTypedRenderer<MDRecordingSink>;
+
+#endif
@@ -0,0 +1,37 @@
+#include "md_ref_library.h"
+
+#include "md_text_label.h"
+
+#include <godot_cpp/core/class_db.hpp>
+
+using namespace godot;
+
+void MDRefLibrary::_bind_methods() {
+	ClassDB::bind_static_method("MDRefLibrary", D_METHOD("build", "markdown"), &MDRefLibrary::build);
+	ClassDB::bind_method(D_METHOD("get_definition_count"), &MDRefLibrary::get_definition_count);
+}
+
+MDRefLibrary::~MDRefLibrary() {
+	md_ref_library_free(_library);
+}
+
+/**
+ * Build a library from every link reference definition in the markdown. Anything else in it is ignored.
+ */
+Ref<MDRefLibrary> MDRefLibrary::build(const String& markdown) {
+	CharString md_utf8 = markdown.utf8();
+	MD_REF_LIBRARY* library = md_ref_library_build(md_utf8.get_data(), md_utf8.length(), MDRenderer::PARSER_FLAGS, &MD_GODOT_ALLOCATOR);
+	ERR_FAIL_NULL_V_MSG(library, Ref<MDRefLibrary>(), "[MDRefLibrary] Failed to build the reference library.");
+
+	Ref<MDRefLibrary> result;
+	result.instantiate();
+	result->_library = library;
+	return result;
+}
+
+/**
+ * Number of distinct labels. Later duplicates of a label are ignored, as within a document.
+ */
+int MDRefLibrary::get_definition_count() const {
+	return (int)md_ref_library_size(_library);
+}
@@ -0,0 +1,37 @@
+#ifndef MD_REF_LIBRARY_H
+#define MD_REF_LIBRARY_H
+
+#include "md4c.h"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+
+namespace godot {
+
+/**
+ * Link reference definitions shared by many documents, such as a glossary of "[term]: url" lines.
+ * Built once by MDRefLibrary.build() and never modified afterwards, so one library can be used by any number of
+ * conversions at the same time, on any thread. A document's own definitions take precedence over the library.
+ */
+class MDRefLibrary : public RefCounted {
+	GDCLASS(MDRefLibrary, RefCounted)
+
+private:
+	MD_REF_LIBRARY* _library = nullptr;
+
+protected:
+	static void _bind_methods();
+
+public:
+	static Ref<MDRefLibrary> build(const String& markdown);
+
+	int get_definition_count() const;
+
+	// Native table for MDRenderer. Stays valid while this object is referenced
+	const MD_REF_LIBRARY* get_library() const { return _library; }
+
+	~MDRefLibrary();
+};
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include "md_renderer_impl.h"
+
+#include <algorithm>
+
+template class MDTypedRenderer<MDRenderSink>;
+
+static int _line_start(const MD_CHAR* source, int offset) {
+	while (offset > 0 && source[offset - 1] != '\n')
+		offset--;
+	return offset;
+}
+
+// Offset just after the newline ending the line, or the end of the document
+static int _line_end(const MD_CHAR* source, int size, int offset) {
+	while (offset < size) {
+		if (source[offset++] == '\n')
+			break;
+	}
+	return offset;
+}
+
+static bool _is_blank(const MD_CHAR* source, int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		if (source[i] != ' ' && source[i] != '\t' && source[i] != '\r' && source[i] != '\n')
+			return false;
+	}
+	return true;
+}
+
+/**
+ * md4c only reports a block's text, so its range starts after a heading's #, a list marker or a quote's > and ends
+ * before closing ** or `. Widened to the start of the line of its first text and the end of the line of its last.
+ * Non-blank lines right above and below the text belong to the block as well: code fences, setext underlines,
+ * table delimiter rows. Lines between two blank lines (link reference definitions) stay outside any block.
+ */
+void md_widen_source_range(const MD_CHAR* source, MD_SIZE size, int min_begin, int next_begin, int& r_begin, int& r_end) {
+	int document_size = (int)size;
+	int max_end = next_begin < document_size ? _line_start(source, next_begin) : document_size;
+
+	int begin = std::max(_line_start(source, r_begin), min_begin);
+	while (begin > min_begin) {
+		int line = std::max(_line_start(source, begin - 1), min_begin);
+		if (_is_blank(source, line, begin))
+			break;
+		begin = line;
+	}
+
+	int end = std::max(std::min(_line_end(source, document_size, std::max(r_end - 1, r_begin)), max_end), r_end);
+	while (end < max_end) {
+		int line = std::min(_line_end(source, document_size, end), max_end);
+		if (_is_blank(source, end, line))
+			break;
+		end = line;
+	}
+
+	r_begin = begin;
+	r_end = end;
+}
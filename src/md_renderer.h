@@ -0,0 +1,221 @@
+#ifndef MD_RENDERER_H
+#define MD_RENDERER_H
+
+#include "md4c.h"
+#include "md4c_dialects.h"
+#include "md_string_builder.h"
+
+#include <stdint.h>
+#include <chrono>
+
+// The renderer is independent of godot-cpp so it can run on any thread, or outside the engine entirely.
+// Godot types are converted to these plain structs by the caller before rendering.
+
+enum MD2BBError {
+	MD_OK=0, BAD_BLOCK=1, BAD_SPAN=2, BAD_HEADER_SIZE=3, BUDGET_EXCEEDED=4, OUT_OF_MEMORY=5
+};
+
+/**
+ * Limits for markdown from untrusted sources, e.g. player written text. Zero means unlimited.
+ * A render that exceeds any of them stops with BUDGET_EXCEEDED.
+ */
+struct MDParseBudget {
+	// Size of the UTF-8 source
+	uint32_t max_bytes = 0;
+	// Nesting of block quotes and lists
+	uint32_t max_depth = 0;
+	// Potential inline delimiters in a single paragraph, e.g. thousands of '['
+	uint32_t max_marks = 0;
+	// Block, span and text events rendered
+	uint32_t max_items = 0;
+	// Wall time of the whole render
+	uint32_t max_usec = 0;
+};
+
+/**
+ * What one render produced and cost, e.g. to flag documents that are too expensive for a content budget.
+ * Counts are of md4c's events, before MDTypedRenderer::set_coalesce_text() merges any text.
+ */
+struct MDDocumentStats {
+	uint32_t blocks = 0;
+	uint32_t spans = 0;
+	uint32_t text_runs = 0;
+	uint32_t links = 0;
+	uint32_t images = 0;
+	uint32_t tables = 0;
+	// Deepest block nesting below the document, e.g. 2 for a paragraph in a block quote
+	uint32_t max_depth = 0;
+	uint64_t usec = 0;
+	// md4c's peak buffer sizes and reference library lookups
+	MD_PARSE_STATS md4c = {};
+};
+
+struct MDColor {
+	float r = 0.0f;
+	float g = 0.0f;
+	float b = 0.0f;
+	float a = 1.0f;
+};
+
+struct MDHeaderStyle {
+	// Font size is not pushed when <= 0
+	float font_size = 0.0f;
+	bool bold = false;
+	bool italic = false;
+	bool underlined = false;
+	bool has_color = false;
+	MDColor font_color;
+};
+
+struct MDCellStyle {
+	// Transparent unless a MD2BBCellFormat says otherwise
+	MDColor border_color = { 0.0f, 0.0f, 0.0f, 0.0f };
+	// Left, top, right, bottom
+	float padding[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	MDColor row_bg_odd = { 0.0f, 0.0f, 0.0f, 0.0f };
+	MDColor row_bg_even = { 0.0f, 0.0f, 0.0f, 0.0f };
+	bool size_override = false;
+	float min_size_override[2] = { 0.0f, 0.0f };
+	float max_size_override[2] = { 0.0f, 0.0f };
+};
+
+/**
+ * Plain copy of MD2BBFormat, safe to read from any thread during a render
+ */
+struct MDRenderStyle {
+	MDHeaderStyle headers[6];
+	MDCellStyle table_head;
+	MDCellStyle table_body;
+};
+
+/**
+ * Receives the output of MDRenderer as a RichTextLabel style tag stack.
+ * Every push_* is matched by exactly one pop(). Newlines are sent as text.
+ * Implemented by MDLabelSink (a live MDTextLabel), MDBBCodeSink (a BBCode string) and MDRecordingSink (an opcode stream).
+ */
+class MDRenderSink {
+public:
+	virtual ~MDRenderSink() {}
+
+	// Sent before anything else with the whole document, which the pointers given to track_source point into
+	virtual void begin_document(const MD_CHAR* text, MD_SIZE size) {}
+
+	// Structure notifications. enter_block is sent after the block's own tags are pushed,
+	// leave_block before they are popped.
+	virtual void enter_block(MD_BLOCKTYPE block_type) {}
+	virtual void leave_block(MD_BLOCKTYPE block_type) {}
+
+	virtual void push_font_size(float size) = 0;
+	virtual void push_bold() = 0;
+	virtual void push_italics() = 0;
+	virtual void push_underline() = 0;
+	virtual void push_strikethrough() = 0;
+	virtual void push_mono() = 0;
+	virtual void push_color(const MDColor& color) = 0;
+	virtual void push_paragraph() = 0;
+	virtual void push_list(bool ordered, MD_CHAR mark) = 0;
+	virtual void push_table(int columns) = 0;
+	// Applies to all following cells, does not push
+	virtual void set_cell_style(const MDCellStyle& style) = 0;
+	virtual void push_cell() = 0;
+	virtual void pop() = 0;
+
+	// Text is UTF-8 and not null-terminated. It points into the source document where md4c allows it,
+	// unless the renderer coalesces text runs.
+	virtual void add_text(const MD_CHAR* text, MD_SIZE size) = 0;
+	// Sent for every text event md4c reports, before it is passed on or merged into a run.
+	// Lets sinks map output back to the source document even when add_text receives a copy
+	// or decoded entities.
+	virtual void track_source(const MD_CHAR* text, MD_SIZE size) {}
+	virtual void add_image(const MD_CHAR* src, MD_SIZE size) = 0;
+
+	// True when the sink couldn't allocate room for its output, which fails the render with OUT_OF_MEMORY
+	virtual bool failed() const { return false; }
+};
+
+/**
+ * Converts md4c callbacks into calls on a sink. Holds no global state, so separate
+ * renderers can run concurrently on different threads.
+ *
+ * Sink is either MDRenderSink, so any sink can be passed and every call is virtual, or a final
+ * sink class. Then the sink's methods are called directly and inlined into the md4c callbacks,
+ * leaving md4c's function pointer as the only indirection per event. The member definitions are
+ * in md_renderer_impl.h, instantiated in the sink's own translation unit.
+ */
+template <class Sink>
+class MDTypedRenderer {
+public:
+	// Dialect used by everything in this extension, see md4c.h:306.
+	// md4c can be built specialized for exactly these flags, so they are defined in md4c_dialects.h
+	static const unsigned PARSER_FLAGS = MD4C_DIALECT_GODOT_FLAGS;
+
+	// allocator may be null to use the C runtime
+	MDTypedRenderer(const MDRenderStyle& style, Sink& sink, const MD_ALLOCATOR* allocator = nullptr) :
+			_style(style), _sink(sink), _allocator(allocator), _run_buffer(allocator) {}
+
+	// Optional shared link reference definitions, used for labels the document doesn't define itself
+	void set_ref_library(const MD_REF_LIBRARY* library) { _ref_library = library; }
+	// Merge adjacent text, escapes, decoded entities and line breaks of the same style into one add_text call,
+	// sent at the next span or block boundary. Worth it when every add_text is expensive for the sink.
+	void set_coalesce_text(bool coalesce) { _coalesce_text = coalesce; }
+	void set_budget(const MDParseBudget& budget) { _budget = budget; }
+
+	int render(const MD_CHAR* text, MD_SIZE size);
+	// Reason for the last non-zero return of render(), or nullptr
+	const char* get_error() const { return _error; }
+	// Statistics of the last render(), also when it failed
+	const MDDocumentStats& get_stats() const { return _stats; }
+
+private:
+	const MDRenderStyle& _style;
+	Sink& _sink;
+	const MD_ALLOCATOR* _allocator;
+	const MD_REF_LIBRARY* _ref_library = nullptr;
+	const char* _error = nullptr;
+	MDDocumentStats _stats;
+	uint32_t _depth = 0;
+
+	MDParseBudget _budget;
+	uint32_t _items = 0;
+	bool _budget_exceeded = false;
+	std::chrono::steady_clock::time_point _deadline;
+
+	bool _coalesce_text = false;
+	// Pending text run. Points into the source while the merged events were contiguous there,
+	// otherwise into _run_buffer
+	const MD_CHAR* _run = nullptr;
+	MD_SIZE _run_size = 0;
+	MDStringBuilder _run_buffer;
+	bool _out_of_memory = false;
+
+	static const MD_PARSER _parser;
+
+	bool _over_budget();
+	void _queue_text(const MD_CHAR* text, MD_SIZE size);
+	void _queue_copy(const MD_CHAR* text, MD_SIZE size);
+	void _flush_text();
+
+	// Callbacks for md_parse()
+	int _handle_md_block(MD_BLOCKTYPE block_type, void* detail, bool exiting);
+	int _handle_md_span(MD_SPANTYPE span_type, void* detail, bool exiting);
+	int _handle_md_text(MD_TEXTTYPE text_type, const MD_CHAR* text, MD_SIZE size);
+
+	// Tags with more complex behaviour than just tag replacement
+	int _handle_md_header(void* detail, bool exiting);
+
+	static int _enter_block(MD_BLOCKTYPE block_type, void* detail, void* user_data);
+	static int _leave_block(MD_BLOCKTYPE block_type, void* detail, void* user_data);
+	static int _enter_span(MD_SPANTYPE span_type, void* detail, void* user_data);
+	static int _leave_span(MD_SPANTYPE span_type, void* detail, void* user_data);
+	static int _text(MD_TEXTTYPE text_type, const MD_CHAR* text, MD_SIZE size, void* user_data);
+};
+
+// Widen a block's source range [r_begin, r_end), found from its text, to whole lines so its markup is covered too.
+// Stays at or after min_begin and before the line of next_begin. Defined in md_renderer.cpp
+void md_widen_source_range(const MD_CHAR* source, MD_SIZE size, int min_begin, int next_begin, int& r_begin, int& r_end);
+
+// Renders into any sink through virtual calls. Instantiated in md_renderer.cpp
+typedef MDTypedRenderer<MDRenderSink> MDRenderer;
+extern template class MDTypedRenderer<MDRenderSink>;
+
+#endif
@@ -0,0 +1,409 @@
+#ifndef MD_RENDERER_IMPL_H
+#define MD_RENDERER_IMPL_H
+
+// Member definitions of MDTypedRenderer. Only include this where the renderer is
+// instantiated for a sink, which should be the translation unit defining that sink.
+
+#include "md_entity.h"
+#include "md_monitors.h"
+#include "md_renderer.h"
+#include "md_trace.h"
+
+#define __POP_IF_EXIT if (exiting) { _sink.pop(); return MD_OK; }
+
+static const MD_CHAR NEWLINE[] = "\n";
+
+template <class Sink>
+const MD_PARSER MDTypedRenderer<Sink>::_parser = {
+	// Need to set to 0
+	// Not sure why docs for md4c just say so ¯\_(ツ)_/¯
+	0,
+	PARSER_FLAGS,
+	&MDTypedRenderer<Sink>::_enter_block,
+	&MDTypedRenderer<Sink>::_leave_block,
+	&MDTypedRenderer<Sink>::_enter_span,
+	&MDTypedRenderer<Sink>::_leave_span,
+	&MDTypedRenderer<Sink>::_text,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	0,
+	0,
+	nullptr
+};
+
+template <class Sink>
+int MDTypedRenderer<Sink>::render(const MD_CHAR* text, MD_SIZE size) {
+	_error = nullptr;
+	if (_budget.max_bytes > 0 && size > _budget.max_bytes) {
+		_error = "Markdown is larger than the parse budget allows.";
+		return BUDGET_EXCEEDED;
+	}
+	_items = 0;
+	_budget_exceeded = false;
+	_out_of_memory = false;
+	_stats = MDDocumentStats();
+	_depth = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (_budget.max_usec > 0)
+		_deadline = start + std::chrono::microseconds(_budget.max_usec);
+
+	MD_PARSER parser = _parser;
+	parser.allocator = _allocator;
+	parser.ref_library = _ref_library;
+	parser.max_nesting = _budget.max_depth;
+	parser.max_marks = _budget.max_marks;
+	parser.stats = &_stats.md4c;
+	_sink.begin_document(text, size);
+	MD_TRACE_BEGIN("MDRenderer.render");
+	int err = md_parse(text, size, &parser, this);
+	MD_TRACE_END();
+	if (err == MD_LIMIT_EXCEEDED) {
+		_error = "Markdown nests too deep or has too many inline marks for the parse budget.";
+		err = BUDGET_EXCEEDED;
+	}
+	if (err == MD_OK) {
+		_flush_text();
+		if (_out_of_memory || _sink.failed()) {
+			_error = "Out of memory for the rendered output.";
+			err = OUT_OF_MEMORY;
+		}
+	} else {
+		_run_size = 0;
+	}
+	std::chrono::microseconds elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	_stats.usec = (uint64_t)elapsed.count();
+	MDMonitors::record_parse(_stats.usec, size, _stats.md4c);
+	return err;
+}
+
+template <class Sink>
+int MDTypedRenderer<Sink>::_enter_block(MD_BLOCKTYPE block_type, void* detail, void* user_data) {
+	return ((MDTypedRenderer<Sink>*)user_data)->_handle_md_block(block_type, detail, false);
+}
+
+template <class Sink>
+int MDTypedRenderer<Sink>::_leave_block(MD_BLOCKTYPE block_type, void* detail, void* user_data) {
+	return ((MDTypedRenderer<Sink>*)user_data)->_handle_md_block(block_type, detail, true);
+}
+
+template <class Sink>
+int MDTypedRenderer<Sink>::_enter_span(MD_SPANTYPE span_type, void* detail, void* user_data) {
+	return ((MDTypedRenderer<Sink>*)user_data)->_handle_md_span(span_type, detail, false);
+}
+
+template <class Sink>
+int MDTypedRenderer<Sink>::_leave_span(MD_SPANTYPE span_type, void* detail, void* user_data) {
+	return ((MDTypedRenderer<Sink>*)user_data)->_handle_md_span(span_type, detail, true);
+}
+
+template <class Sink>
+int MDTypedRenderer<Sink>::_text(MD_TEXTTYPE text_type, const MD_CHAR* text, MD_SIZE size, void* user_data) {
+	return ((MDTypedRenderer<Sink>*)user_data)->_handle_md_text(text_type, text, size);
+}
+
+template <class Sink>
+int MDTypedRenderer<Sink>::_handle_md_block(MD_BLOCKTYPE block_type, void* detail, bool exiting) {
+	if (_over_budget())
+		return BUDGET_EXCEEDED;
+	_flush_text();
+	if (exiting) {
+		_sink.leave_block(block_type);
+		_depth -= (block_type != MD_BLOCK_DOC);
+	} else if (block_type != MD_BLOCK_DOC) {
+		_stats.blocks++;
+		_stats.tables += (block_type == MD_BLOCK_TABLE);
+		if (++_depth > _stats.max_depth)
+			_stats.max_depth = _depth;
+	}
+	switch (block_type) {
+		case MD_BLOCK_DOC:
+			// No BBCode equivalent
+			break;
+		case MD_BLOCK_QUOTE:
+			// No BBCode equivalent
+			break;
+		case MD_BLOCK_UL:
+			__POP_IF_EXIT
+			_sink.push_list(false, ((MD_BLOCK_UL_DETAIL*)detail)->mark);
+			break;
+		case MD_BLOCK_OL:
+			__POP_IF_EXIT
+			_sink.push_list(true, ((MD_BLOCK_OL_DETAIL*)detail)->mark_delimiter);
+			break;
+		case MD_BLOCK_LI:
+			// BBCode list items are just separated by newlines
+			if (exiting) {
+				_sink.add_text(NEWLINE, 1);
+			}
+			break;
+		case MD_BLOCK_HR:
+			_sink.add_text(NEWLINE, 1);
+			break;
+		case MD_BLOCK_H:
+			{
+				int err = _handle_md_header(detail, exiting);
+				if (err != MD_OK)
+					return err;
+			}
+			break;
+		case MD_BLOCK_CODE:
+			// TODO: potentially differentiate fenced codeblocks from indented codeblocks?
+			__POP_IF_EXIT
+			_sink.push_mono();
+			break;
+		case MD_BLOCK_HTML:
+			// Only reachable without MD_FLAG_NOHTMLBLOCKS. Godot can't render HTML, so show it as code instead
+			__POP_IF_EXIT
+			_sink.push_mono();
+			break;
+		case MD_BLOCK_P:
+			__POP_IF_EXIT
+			_sink.push_paragraph();
+			break;
+		case MD_BLOCK_TABLE:
+			__POP_IF_EXIT
+			_sink.push_table(((MD_BLOCK_TABLE_DETAIL*)detail)->col_count);
+			break;
+		case MD_BLOCK_THEAD:
+			// Formatting for table cells is set at table head and table body
+			if (!exiting) {
+				_sink.set_cell_style(_style.table_head);
+			}
+			break;
+		case MD_BLOCK_TBODY:
+			if (!exiting) {
+				_sink.set_cell_style(_style.table_body);
+			}
+			break;
+		case MD_BLOCK_TR:
+			// No BBCode equivalent
+			break;
+		case MD_BLOCK_TH:
+			__POP_IF_EXIT
+			_sink.push_cell();
+			break;
+		case MD_BLOCK_TD:
+			__POP_IF_EXIT
+			_sink.push_cell();
+			break;
+		default:
+			_error = "Unrecognized markdown block type.";
+			return BAD_BLOCK;
+	}
+
+	if (!exiting) {
+		_sink.enter_block(block_type);
+	}
+	return MD_OK;
+}
+
+template <class Sink>
+int MDTypedRenderer<Sink>::_handle_md_span(MD_SPANTYPE span_type, void* detail, bool exiting) {
+	if (_over_budget())
+		return BUDGET_EXCEEDED;
+	_flush_text();
+	if (!exiting) {
+		_stats.spans++;
+		_stats.links += (span_type == MD_SPAN_A || span_type == MD_SPAN_WIKILINK);
+		_stats.images += (span_type == MD_SPAN_IMG);
+	}
+	switch (span_type) {
+		case MD_SPAN_EM:
+			__POP_IF_EXIT
+			_sink.push_italics();
+			break;
+		case MD_SPAN_STRONG:
+			__POP_IF_EXIT
+			_sink.push_bold();
+			break;
+		case MD_SPAN_A:
+			// Links are not rendered yet, only their text
+			break;
+		case MD_SPAN_IMG:
+			// Image push and pop is done in one step - so don't pop on exit again
+			if (!exiting) {
+				MD_SPAN_IMG_DETAIL* img_detail = (MD_SPAN_IMG_DETAIL*)detail;
+				_sink.add_image(img_detail->src.text, img_detail->src.size);
+			}
+			break;
+		case MD_SPAN_CODE:
+			__POP_IF_EXIT
+			_sink.push_mono();
+			break;
+		case MD_SPAN_DEL:
+			__POP_IF_EXIT
+			_sink.push_strikethrough();
+			break;
+		case MD_SPAN_LATEXMATH:
+		case MD_SPAN_LATEXMATH_DISPLAY:
+			_error = "LATEX rendering is not supported by Godot.";
+			return BAD_SPAN;
+		case MD_SPAN_WIKILINK:
+			_error = "Wikilinks are not yet supported. Use normal links with filepaths instead.";
+			return BAD_SPAN;
+		case MD_SPAN_U:
+			__POP_IF_EXIT
+			_sink.push_underline();
+			break;
+		default:
+			_error = "Unrecognized markdown span type.";
+			return BAD_SPAN;
+	}
+	return MD_OK;
+}
+
+template <class Sink>
+int MDTypedRenderer<Sink>::_handle_md_text(MD_TEXTTYPE text_type, const MD_CHAR* text, MD_SIZE size) {
+	if (_over_budget())
+		return BUDGET_EXCEEDED;
+	_stats.text_runs++;
+	switch (text_type) {
+		case MD_TEXT_NORMAL:
+		case MD_TEXT_CODE:
+			_sink.track_source(text, size);
+			_queue_text(text, size);
+			break;
+		case MD_TEXT_ENTITY:
+			{
+				_sink.track_source(text, size);
+				// Decoded into the current text run. Unknown entities are kept as written
+				MD_CHAR decoded[MD_ENTITY_MAX_UTF8];
+				int decoded_size = md_decode_entity(text, size, decoded);
+				if (decoded_size > 0) {
+					// decoded is gone once this returns, so it can't be the start of a run
+					_queue_copy(decoded, decoded_size);
+				} else {
+					_queue_text(text, size);
+				}
+			}
+			break;
+		case MD_TEXT_NULLCHAR:
+			break;
+		case MD_TEXT_BR:
+		case MD_TEXT_SOFTBR:
+			_queue_text(NEWLINE, 1);
+			break;
+		case MD_TEXT_HTML:
+			// Not supported
+			break;
+		case MD_TEXT_LATEXMATH:
+			// Not supported
+			break;
+		default:
+			// Unknown text is skipped rather than aborting the document
+			break;
+	}
+	return MD_OK;
+}
+
+/**
+ * Count one more event against the budget. The clock is only read every 64 events, as that costs
+ * more than the rest of a typical event.
+ * Stays exceeded once it is, as md4c only abandons the current block when a callback fails.
+ */
+template <class Sink>
+bool MDTypedRenderer<Sink>::_over_budget() {
+	if (_budget_exceeded)
+		return true;
+	_items++;
+	if (_budget.max_items > 0 && _items > _budget.max_items) {
+		_error = "Markdown produces more items than the parse budget allows.";
+		_budget_exceeded = true;
+	} else if (_budget.max_usec > 0 && (_items & 63) == 0 && std::chrono::steady_clock::now() > _deadline) {
+		_error = "Markdown took longer to render than the parse budget allows.";
+		_budget_exceeded = true;
+	}
+	return _budget_exceeded;
+}
+
+template <class Sink>
+void MDTypedRenderer<Sink>::_queue_text(const MD_CHAR* text, MD_SIZE size) {
+	if (!_coalesce_text) {
+		_sink.add_text(text, size);
+		return;
+	}
+	if (_run_size == 0) {
+		_run = text;
+		_run_size = size;
+	} else if (_run != _run_buffer.get_data() && _run + _run_size == text) {
+		// Split by md4c at a mark that turned out to be plain text, so still one slice of the source
+		_run_size += size;
+	} else {
+		_queue_copy(text, size);
+	}
+}
+
+/**
+ * Add text that doesn't outlive the md4c callback to the run, by copying it into _run_buffer
+ */
+template <class Sink>
+void MDTypedRenderer<Sink>::_queue_copy(const MD_CHAR* text, MD_SIZE size) {
+	if (!_coalesce_text) {
+		_sink.add_text(text, size);
+		return;
+	}
+	if (_run_size == 0) {
+		_run_buffer.clear();
+	} else if (_run != _run_buffer.get_data()) {
+		_run_buffer.clear();
+		_run_buffer.append(_run, _run_size);
+	}
+	_run_buffer.append(text, size);
+	// clear() forgets a failure, so remember it for render()
+	_out_of_memory |= _run_buffer.failed();
+	_run = _run_buffer.get_data();
+	_run_size = _run_buffer.size();
+}
+
+template <class Sink>
+void MDTypedRenderer<Sink>::_flush_text() {
+	if (_run_size == 0)
+		return;
+	_sink.add_text(_run, _run_size);
+	_run = nullptr;
+	_run_size = 0;
+}
+
+/**
+ * Handle a header block, using the matching MDHeaderStyle
+ */
+template <class Sink>
+int MDTypedRenderer<Sink>::_handle_md_header(void* detail, bool exiting) {
+	unsigned level = ((MD_BLOCK_H_DETAIL*)detail)->level;
+	if (level < 1 || level > 6) {
+		_error = "Invalid header size.";
+		return BAD_HEADER_SIZE;
+	}
+	const MDHeaderStyle& header_style = _style.headers[level - 1];
+	if (!exiting) {
+		if (header_style.font_size > 0.0f)
+			_sink.push_font_size(header_style.font_size);
+		if (header_style.bold)
+			_sink.push_bold();
+		if (header_style.italic)
+			_sink.push_italics();
+		if (header_style.underlined)
+			_sink.push_underline();
+		if (header_style.has_color)
+			_sink.push_color(header_style.font_color);
+	} else {
+		if (header_style.has_color)
+			_sink.pop();
+		if (header_style.underlined)
+			_sink.pop();
+		if (header_style.italic)
+			_sink.pop();
+		if (header_style.bold)
+			_sink.pop();
+		if (header_style.font_size > 0.0f)
+			_sink.pop();
+		_sink.add_text(NEWLINE, 1);
+	}
+	return MD_OK;
+}
+
+#undef __POP_IF_EXIT
+
+#endif
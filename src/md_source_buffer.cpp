@@ -0,0 +1,65 @@
+#include "md_source_buffer.h"
+
+#include <godot_cpp/classes/file_access.hpp>
+
+#include <stdint.h>
+#include <string.h>
+
+using namespace godot;
+
+// md4c measures documents in MD_SIZE
+static const uint64_t MAX_SOURCE_SIZE = UINT32_MAX;
+
+/**
+ * Load a file's bytes without decoding them, with a single read into memory of our own. The file isn't kept open
+ * or mapped, so it can be rewritten while the document is shown. Works for res:// inside an exported PCK as well.
+ * Keeps the previous contents if the file can't be loaded.
+ */
+Error MDSourceBuffer::load_file(const String& path) {
+	Ref<FileAccess> file = FileAccess::open(path, FileAccess::READ);
+	if (file.is_null())
+		return FileAccess::get_open_error();
+	uint64_t length = file->get_length();
+	ERR_FAIL_COND_V_MSG(length > MAX_SOURCE_SIZE, ERR_OUT_OF_MEMORY, "Markdown file is too large: " + path);
+	PackedByteArray bytes = file->get_buffer((int64_t)length);
+	ERR_FAIL_COND_V_MSG((uint64_t)bytes.size() != length, ERR_FILE_CORRUPT, "Cannot read markdown file " + path);
+	_bytes = bytes;
+	return OK;
+}
+
+void MDSourceBuffer::set_bytes(const PackedByteArray& bytes) {
+	clear();
+	ERR_FAIL_COND_MSG((uint64_t)bytes.size() > MAX_SOURCE_SIZE, "Markdown is too large.");
+	_bytes = bytes;
+}
+
+void MDSourceBuffer::append_bytes(const PackedByteArray& bytes) {
+	if (bytes.is_empty())
+		return;
+	size_t size = (size_t)_bytes.size();
+	ERR_FAIL_COND_MSG(size + (uint64_t)bytes.size() > MAX_SOURCE_SIZE, "Markdown is too large.");
+	// PackedByteArray grows its capacity in powers of two, so repeated appends stay amortized O(1)
+	_bytes.resize((int64_t)(size + bytes.size()));
+	memcpy(_bytes.ptrw() + size, bytes.ptr(), (size_t)bytes.size());
+}
+
+void MDSourceBuffer::clear() {
+	_bytes = PackedByteArray();
+}
+
+const MD_CHAR* MDSourceBuffer::get_data() const {
+	const uint8_t* data = _bytes.ptr();
+	// md4c is never given a null pointer, even for an empty document
+	return data != nullptr ? (const MD_CHAR*)data + _bom_size() : "";
+}
+
+MD_SIZE MDSourceBuffer::size() const {
+	return (MD_SIZE)((size_t)_bytes.size() - _bom_size());
+}
+
+size_t MDSourceBuffer::_bom_size() const {
+	const uint8_t* data = _bytes.ptr();
+	if (_bytes.size() >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+		return 3;
+	return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef MD_SOURCE_BUFFER_H
+#define MD_SOURCE_BUFFER_H
+
+#include "md4c.h"
+
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+namespace godot {
+
+/**
+ * UTF-8 markdown of a document, kept as bytes so it goes to md4c without a round trip through String.
+ * Held in a PackedByteArray, shared copy-on-write with whoever passed it in.
+ * A leading UTF-8 byte order mark is not part of the data, as String would drop it as well.
+ */
+class MDSourceBuffer {
+public:
+	Error load_file(const String& path);
+	void set_bytes(const PackedByteArray& bytes);
+	void append_bytes(const PackedByteArray& bytes);
+	void clear();
+
+	const MD_CHAR* get_data() const;
+	MD_SIZE size() const;
+
+private:
+	PackedByteArray _bytes;
+
+	size_t _bom_size() const;
+};
+
+}
+
+#endif
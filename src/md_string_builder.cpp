@@ -0,0 +1,52 @@
+#include "md_string_builder.h"
+
+#include <stdlib.h>
+
+MDStringBuilder::~MDStringBuilder() {
+	if (_data == nullptr)
+		return;
+	if (_allocator != nullptr)
+		_allocator->free_fn(_data, _allocator->userdata);
+	else
+		free(_data);
+}
+
+void MDStringBuilder::reserve(size_t capacity) {
+	if (capacity <= _capacity)
+		return;
+	char* data;
+	if (_allocator == nullptr)
+		data = (char*)realloc(_data, capacity);
+	else if (_data == nullptr)
+		data = (char*)_allocator->malloc_fn(capacity, _allocator->userdata);
+	else
+		data = (char*)_allocator->realloc_fn(_data, capacity, _allocator->userdata);
+	if (data == nullptr) {
+		_failed = true;
+		return;
+	}
+	_data = data;
+	_capacity = capacity;
+}
+
+bool MDStringBuilder::_grow(size_t min_capacity) {
+	size_t capacity = _capacity > 0 ? _capacity * 2 : 64;
+	while (capacity < min_capacity)
+		capacity *= 2;
+	reserve(capacity);
+	return _capacity >= min_capacity;
+}
+
+void MDStringBuilder::append_int(int value) {
+	char digits[12];
+	int count = 0;
+	unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+	do {
+		digits[count++] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+	if (value < 0)
+		append_char('-');
+	while (count > 0)
+		append_char(digits[--count]);
+}
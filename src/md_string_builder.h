@@ -0,0 +1,59 @@
+#ifndef MD_STRING_BUILDER_H
+#define MD_STRING_BUILDER_H
+
+#include "md4c.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Growable UTF-8 byte buffer. Capacity doubles when exceeded so appends are amortized O(1).
+ * When an allocation fails the buffer keeps what it has, drops the appends that don't fit and reports
+ * failed() until it is cleared, so a render can fail instead of the process.
+ */
+class MDStringBuilder {
+public:
+	// allocator may be null to use the C runtime
+	explicit MDStringBuilder(const MD_ALLOCATOR* allocator = nullptr) :
+			_allocator(allocator) {}
+	~MDStringBuilder();
+	MDStringBuilder(const MDStringBuilder&) = delete;
+	MDStringBuilder& operator=(const MDStringBuilder&) = delete;
+
+	void reserve(size_t capacity);
+	// Also forgets a failed allocation, the capacity is kept
+	void clear() {
+		_size = 0;
+		_failed = false;
+	}
+
+	void append(const char* text, size_t size) {
+		if (_size + size > _capacity && !_grow(_size + size))
+			return;
+		memcpy(_data + _size, text, size);
+		_size += size;
+	}
+	void append(const char* text) { append(text, strlen(text)); }
+	void append_char(char c) {
+		if (_size == _capacity && !_grow(_size + 1))
+			return;
+		_data[_size++] = c;
+	}
+	void append_int(int value);
+
+	const char* get_data() const { return _data; }
+	size_t size() const { return _size; }
+	// True once an allocation failed, so the content is incomplete
+	bool failed() const { return _failed; }
+
+private:
+	const MD_ALLOCATOR* _allocator;
+	char* _data = nullptr;
+	size_t _size = 0;
+	size_t _capacity = 0;
+	bool _failed = false;
+
+	bool _grow(size_t min_capacity);
+};
+
+#endif
@@ -1,61 +1,168 @@
 #include "md_text_label.h"
 
+#include "md_monitors.h"
+#include "md_renderer_impl.h"
+#include "md_trace.h"
+
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
-#define __POP_IF_EXIT if (exiting) { pop(); return MD_OK; }
-
 using namespace godot;
 
 const PackedStringArray HIDDEN_PROPERTIES = {"bbcode_enabled", "text"};
 
+std::atomic<uint64_t> MDTextLabel::_budget_fallback_count{ 0 };
+
+static void* _md_godot_malloc(size_t size, void* userdata) {
+	return memalloc(size);
+}
+
+static void* _md_godot_realloc(void* ptr, size_t size, void* userdata) {
+	return memrealloc(ptr, size);
+}
+
+static void _md_godot_free(void* ptr, void* userdata) {
+	memfree(ptr);
+}
+
+const MD_ALLOCATOR godot::MD_GODOT_ALLOCATOR = { &_md_godot_malloc, &_md_godot_realloc, &_md_godot_free, nullptr };
+
 void MDTextLabel::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_markdown", "p_markdown"), &MDTextLabel::set_markdown);
 	ClassDB::bind_method(D_METHOD("append_markdown", "p_markdown"), &MDTextLabel::append_markdown);
+	ClassDB::bind_method(D_METHOD("set_markdown_utf8", "p_markdown"), &MDTextLabel::set_markdown_utf8);
+	ClassDB::bind_method(D_METHOD("append_markdown_utf8", "p_markdown"), &MDTextLabel::append_markdown_utf8);
+	ClassDB::bind_method(D_METHOD("load_markdown_file", "path"), &MDTextLabel::load_markdown_file);
 	ClassDB::bind_method(D_METHOD("get_markdown"), &MDTextLabel::get_markdown);
 	ClassDB::bind_method(D_METHOD("get_format"), &MDTextLabel::get_format);
 	ClassDB::bind_method(D_METHOD("set_format", "p_format"), &MDTextLabel::set_format);
+	ClassDB::bind_method(D_METHOD("get_reference_library"), &MDTextLabel::get_reference_library);
+	ClassDB::bind_method(D_METHOD("set_reference_library", "p_library"), &MDTextLabel::set_reference_library);
+	ClassDB::bind_method(D_METHOD("scroll_to_anchor", "slug"), &MDTextLabel::scroll_to_anchor);
+	ClassDB::bind_method(D_METHOD("get_anchor_paragraph", "slug"), &MDTextLabel::get_anchor_paragraph);
+	ClassDB::bind_method(D_METHOD("get_anchor_slugs"), &MDTextLabel::get_anchor_slugs);
+	ClassDB::bind_method(D_METHOD("get_block_at_offset", "byte_offset"), &MDTextLabel::get_block_at_offset);
+	ClassDB::bind_method(D_METHOD("get_rendered_item_count"), &MDTextLabel::get_rendered_item_count);
+	ClassDB::bind_method(D_METHOD("get_parse_stats"), &MDTextLabel::get_parse_stats);
+	ClassDB::bind_method(D_METHOD("get_budget_max_bytes"), &MDTextLabel::get_budget_max_bytes);
+	ClassDB::bind_method(D_METHOD("set_budget_max_bytes", "value"), &MDTextLabel::set_budget_max_bytes);
+	ClassDB::bind_method(D_METHOD("get_budget_max_depth"), &MDTextLabel::get_budget_max_depth);
+	ClassDB::bind_method(D_METHOD("set_budget_max_depth", "value"), &MDTextLabel::set_budget_max_depth);
+	ClassDB::bind_method(D_METHOD("get_budget_max_marks"), &MDTextLabel::get_budget_max_marks);
+	ClassDB::bind_method(D_METHOD("set_budget_max_marks", "value"), &MDTextLabel::set_budget_max_marks);
+	ClassDB::bind_method(D_METHOD("get_budget_max_items"), &MDTextLabel::get_budget_max_items);
+	ClassDB::bind_method(D_METHOD("set_budget_max_items", "value"), &MDTextLabel::set_budget_max_items);
+	ClassDB::bind_method(D_METHOD("get_budget_max_usec"), &MDTextLabel::get_budget_max_usec);
+	ClassDB::bind_method(D_METHOD("set_budget_max_usec", "value"), &MDTextLabel::set_budget_max_usec);
+	ClassDB::bind_static_method("MDTextLabel", D_METHOD("get_budget_fallback_count"), &MDTextLabel::get_budget_fallback_count);
 	
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "markdown", PROPERTY_HINT_MULTILINE_TEXT), "set_markdown", "get_markdown");
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "format", PROPERTY_HINT_RESOURCE_TYPE, "MD2BBFormat"), "set_format", "get_format");
+	// Built at runtime with MDRefLibrary.build(), so not stored in scenes
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "reference_library", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NONE), "set_reference_library", "get_reference_library");
+
+	// 0 means unlimited
+	ADD_GROUP("Parse Budget", "budget_");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "budget_max_bytes", PROPERTY_HINT_RANGE, "0,16777216,1,or_greater,suffix:B"), "set_budget_max_bytes", "get_budget_max_bytes");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "budget_max_depth", PROPERTY_HINT_RANGE, "0,256,1,or_greater"), "set_budget_max_depth", "get_budget_max_depth");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "budget_max_marks", PROPERTY_HINT_RANGE, "0,65536,1,or_greater"), "set_budget_max_marks", "get_budget_max_marks");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "budget_max_items", PROPERTY_HINT_RANGE, "0,1000000,1,or_greater"), "set_budget_max_items", "get_budget_max_items");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "budget_max_usec", PROPERTY_HINT_RANGE, "0,1000000,1,or_greater,suffix:us"), "set_budget_max_usec", "get_budget_max_usec");
 }
 
-MDTextLabel::MDTextLabel() {
+namespace godot {
+
+/**
+ * Renders straight into a MDTextLabel's tag stack, and records its anchor map on the way
+ */
+class MDLabelSink final : public MDRenderSink {
+public:
+	// RichTextLabel items created, i.e. pushes, text runs and images
+	int items = 0;
+
+	MDLabelSink(MDTextLabel* label) :
+			_label(label) {}
+
+	// Also sent when a MDRecordingSink is replayed with its source, so the anchor map is rebuilt from the recording
+	void begin_document(const MD_CHAR* text, MD_SIZE size) override {
+		_label->_parse_source = text;
+		_label->_parse_source_size = size;
+	}
+	void enter_block(MD_BLOCKTYPE block_type) override {
+		if (block_type == MD_BLOCK_H) {
+			_label->_in_heading = true;
+			_label->_heading_text = String();
+		}
+		if (MDTextLabel::_is_anchor_block(block_type))
+			_label->_begin_anchor_block();
+	}
+	void leave_block(MD_BLOCKTYPE block_type) override {
+		if (block_type == MD_BLOCK_H)
+			_label->_end_heading();
+		if (MDTextLabel::_is_anchor_block(block_type))
+			_label->_end_anchor_block();
+	}
+
+	void push_font_size(float size) override { items++; _label->push_font_size(size); }
+	void push_bold() override { items++; _label->push_bold(); }
+	void push_italics() override { items++; _label->push_italics(); }
+	void push_underline() override { items++; _label->push_underline(); }
+	void push_strikethrough() override { items++; _label->push_strikethrough(); }
+	void push_mono() override { items++; _label->push_mono(); }
+	void push_color(const MDColor& color) override { items++; _label->push_color(_to_color(color)); }
+	void push_paragraph() override { items++; _label->push_paragraph(HORIZONTAL_ALIGNMENT_LEFT); }
+	void push_list(bool ordered, MD_CHAR mark) override {
+		items++;
+		_label->push_list(0, ordered ? RichTextLabel::LIST_NUMBERS : RichTextLabel::LIST_DOTS, false, String::utf8(&mark, 1));
+	}
+	void push_table(int columns) override { items++; _label->push_table(columns); }
+	void set_cell_style(const MDCellStyle& style) override {
+		_label->set_cell_border_color(_to_color(style.border_color));
+		_label->set_cell_padding(Rect2(style.padding[0], style.padding[1], style.padding[2], style.padding[3]));
+		_label->set_cell_row_background_color(_to_color(style.row_bg_odd), _to_color(style.row_bg_even));
+		if (style.size_override) {
+			_label->set_cell_size_override(Vector2(style.min_size_override[0], style.min_size_override[1]), Vector2(style.max_size_override[0], style.max_size_override[1]));
+		} else {
+			_label->set_cell_size_override(Vector2(), Vector2());
+		}
+	}
+	void push_cell() override { items++; _label->push_cell(); }
+	void pop() override { _label->pop(); }
+
+	void add_text(const MD_CHAR* text, MD_SIZE size) override {
+		items++;
+		String str = String::utf8(text, size);
+		if (_label->_in_heading)
+			_label->_heading_text += str;
+		_label->add_text(str);
+	}
+	void track_source(const MD_CHAR* text, MD_SIZE size) override { _label->_track_anchor_text(text, size); }
+	void add_image(const MD_CHAR* src, MD_SIZE size) override {
+		items++;
+		// Appending the image bbcode here as a string is easier than trying to re-write the image fetching code ourselves
+		_label->append_text("[img]" + String::utf8(src, size) + "[/img]");
+	}
+
+private:
+	MDTextLabel* _label;
 
-	_md_parser = new MD_PARSER();
-    // Need to set to 0
-    // Not sure why docs for md4c just say so ¯\_(ツ)_/¯
-    _md_parser->abi_version = 0;
-    // See md4c.h:306
-    _md_parser->flags = MD_FLAG_TABLES | MD_FLAG_STRIKETHROUGH | MD_FLAG_WIKILINKS | MD_FLAG_UNDERLINE | MD_FLAG_NOHTMLBLOCKS | MD_FLAG_NOHTMLSPANS;
-
-    // Block callbacks
-    _md_parser->enter_block = [](MD_BLOCKTYPE block_type, void* detail, void* user_data) {
-		MDTextLabel* md_label = (MDTextLabel*)user_data;
-        return md_label->_handle_md_block(block_type, detail, md_label->format.ptr(), false);
-    };
-    _md_parser->leave_block = [](MD_BLOCKTYPE block_type, void* detail, void* user_data) {
-		MDTextLabel* md_label = (MDTextLabel*)user_data;
-        return md_label->_handle_md_block(block_type, detail, md_label->format.ptr(), true);
-    };
-    // Span callbacks
-    _md_parser->enter_span = [](MD_SPANTYPE span_type, void* detail, void* user_data) {
-		MDTextLabel* md_label = (MDTextLabel*)user_data;
-        return md_label->_handle_md_span(span_type, detail, md_label->format.ptr(), false);
-    };
-    _md_parser->leave_span = [](MD_SPANTYPE span_type, void* detail, void* user_data) {
-		MDTextLabel* md_label = (MDTextLabel*)user_data;
-        return md_label->_handle_md_span(span_type, detail, md_label->format.ptr(), true);
-    };
-    // Text callback
-    _md_parser->text = [](MD_TEXTTYPE text_type, const MD_CHAR* text, MD_SIZE size, void* user_data) {
-		MDTextLabel* md_label = (MDTextLabel*)user_data;
-        return md_label->_handle_md_text(text_type, text, size, md_label->format.ptr());
-    };
+	static Color _to_color(const MDColor& color) { return Color(color.r, color.g, color.b, color.a); }
+};
+
+}
+
+MDTextLabel::MDTextLabel() {
+	MDMonitors::live_labels.fetch_add(1, std::memory_order_relaxed);
 }
 
 MDTextLabel::~MDTextLabel() {
-	delete _md_parser;
+	MDMonitors::live_labels.fetch_sub(1, std::memory_order_relaxed);
+}
+
+static void _record_label_update(std::chrono::steady_clock::time_point start, int items) {
+	std::chrono::microseconds elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	MDMonitors::label_usec.fetch_add((uint64_t)elapsed.count(), std::memory_order_relaxed);
+	MDMonitors::label_items.fetch_add((uint64_t)items, std::memory_order_relaxed);
 }
 
 void MDTextLabel::_validate_property(PropertyInfo& property) {
@@ -66,32 +173,161 @@ void MDTextLabel::_validate_property(PropertyInfo& property) {
 }
 
 void MDTextLabel::set_markdown(const String p_markdown) {
+	MD_TRACE_SCOPE("MDTextLabel.set_markdown");
 	ERR_FAIL_COND(format.is_null());
 	if (!is_using_bbcode())
 		set_use_bbcode(true);
-	markdown = p_markdown;
-    int err = _parse_markdown(markdown);
-	ERR_FAIL_COND_MSG(err != MD_OK, "Failed to parse markdown, error code " + err);
+	_source.set_bytes(p_markdown.to_utf8_buffer());
+	_markdown = p_markdown;
+	_markdown_valid = true;
+    int err = _parse_markdown();
+	_trace_layout();
+	ERR_FAIL_COND_MSG(err != MD_OK, "Failed to parse markdown, error code " + String::num_int64(err));
 }
 
 void MDTextLabel::append_markdown(const String p_markdown) {
+	MD_TRACE_SCOPE("MDTextLabel.append_markdown");
+	ERR_FAIL_COND(format.is_null());
+	if (!is_using_bbcode())
+		set_use_bbcode(true);
+	// Only the new text is encoded. The markdown property is decoded again if someone reads it
+	_source.append_bytes(p_markdown.to_utf8_buffer());
+	_markdown = String();
+	_markdown_valid = false;
+    int err = _parse_markdown();
+	_trace_layout();
+	ERR_FAIL_COND_MSG(err != MD_OK, "Failed to parse markdown, error code " + String::num_int64(err));
+}
+
+/**
+ * Like set_markdown(), for markdown that already is UTF-8, e.g. from FileAccess.get_buffer() or a network packet.
+ * The bytes are parsed as they are and shared with the caller rather than copied, get_markdown() decodes them
+ * only when it's called.
+ */
+void MDTextLabel::set_markdown_utf8(const PackedByteArray& p_markdown) {
+	MD_TRACE_SCOPE("MDTextLabel.set_markdown_utf8");
 	ERR_FAIL_COND(format.is_null());
 	if (!is_using_bbcode())
 		set_use_bbcode(true);
-	markdown += p_markdown;
-    int err = _parse_markdown(markdown);
-	ERR_FAIL_COND_MSG(err != MD_OK, "Failed to parse markdown, error code " + err);
+	_source.set_bytes(p_markdown);
+	_markdown = String();
+	_markdown_valid = false;
+	int err = _parse_markdown();
+	_trace_layout();
+	ERR_FAIL_COND_MSG(err != MD_OK, "Failed to parse markdown, error code " + String::num_int64(err));
+}
+
+/**
+ * Like append_markdown(), for markdown that already is UTF-8
+ */
+void MDTextLabel::append_markdown_utf8(const PackedByteArray& p_markdown) {
+	MD_TRACE_SCOPE("MDTextLabel.append_markdown_utf8");
+	ERR_FAIL_COND(format.is_null());
+	if (!is_using_bbcode())
+		set_use_bbcode(true);
+	_source.append_bytes(p_markdown);
+	_markdown = String();
+	_markdown_valid = false;
+	int err = _parse_markdown();
+	_trace_layout();
+	ERR_FAIL_COND_MSG(err != MD_OK, "Failed to parse markdown, error code " + String::num_int64(err));
+}
+
+/**
+ * Show a UTF-8 markdown file. The file is read once and its bytes go to the parser as they are, instead of being
+ * decoded into a String and encoded again. get_markdown() decodes them only when it's called.
+ */
+Error MDTextLabel::load_markdown_file(const String& path) {
+	MD_TRACE_SCOPE("MDTextLabel.load_markdown_file");
+	ERR_FAIL_COND_V(format.is_null(), ERR_UNCONFIGURED);
+	Error error = _source.load_file(path);
+	ERR_FAIL_COND_V_MSG(error != OK, error, "Cannot load markdown file " + path);
+	if (!is_using_bbcode())
+		set_use_bbcode(true);
+	_markdown = String();
+	_markdown_valid = false;
+	int err = _parse_markdown();
+	_trace_layout();
+	ERR_FAIL_COND_V_MSG(err != MD_OK, ERR_PARSE_ERROR, "Failed to parse markdown, error code " + String::num_int64(err));
+	return OK;
 }
 
+void MDTextLabel::_trace_layout() {
+#ifdef MD_TRACE
+	// RichTextLabel lays out lazily, usually when it's next drawn. While tracing, do it right away so the
+	// trace shows it within the update that caused it. get_content_height() validates the line caches
+	if (md_trace_is_enabled()) {
+		MD_TRACE_SCOPE("RichTextLabel.layout");
+		get_content_height();
+	}
+#endif
+}
 
-int MDTextLabel::_parse_markdown(String md_text) {
+
+int MDTextLabel::_parse_markdown() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     set_text("");
-    return md_parse(md_text.utf8().get_data(), md_text.length(), _md_parser, this);
+	_clear_anchors();
+	MDRenderStyle style;
+	format->get_render_style(style);
+	MDLabelSink sink(this);
+	MDTypedRenderer<MDLabelSink> renderer(style, sink, &MD_GODOT_ALLOCATOR);
+	// Every add_text is a separate RichTextLabel item and a call into the engine
+	renderer.set_coalesce_text(true);
+	renderer.set_budget(budget);
+	if (reference_library.is_valid())
+		renderer.set_ref_library(reference_library->get_library());
+	int err = renderer.render(_source.get_data(), _source.size());
+	if (err == MD_OK)
+		_finish_anchors();
+	_parse_source = nullptr;
+	_parse_source_size = 0;
+	_rendered_item_count = sink.items;
+	_parse_stats = renderer.get_stats();
+	if (err == BUDGET_EXCEEDED) {
+		// Expected for hostile input rather than a bug, so not reported as an error
+		UtilityFunctions::print_verbose(String("[MDTextLabel] ") + renderer.get_error() + " Showing it as plain text.");
+		_budget_fallback_count.fetch_add(1, std::memory_order_relaxed);
+		clear();
+		_clear_anchors();
+		// add_text() doesn't parse BBCode, so the markdown shows exactly as written. Cut to the byte budget,
+		// or a huge document would cost as much to lay out as plain text as the parse would have
+		const MD_CHAR* data = _source.get_data();
+		MD_SIZE size = _source.size();
+		if (budget.max_bytes > 0 && size > budget.max_bytes) {
+			size = budget.max_bytes;
+			// Back up to the start of a UTF-8 sequence, so no character is cut in half
+			while (size > 0 && ((unsigned char)data[size] & 0xC0) == 0x80)
+				size--;
+			add_text(String::utf8(data, size) + U"\u2026");
+		} else {
+			add_text(String::utf8(data, size));
+		}
+		_rendered_item_count = 1;
+		_record_label_update(start, _rendered_item_count);
+		return MD_OK;
+	}
+	if (err != MD_OK && renderer.get_error() != nullptr) {
+		ERR_PRINT(String("[MDTextLabel] ") + renderer.get_error());
+	}
+	_record_label_update(start, _rendered_item_count);
+	return err;
+}
+
+/**
+ * Number of times any MDTextLabel went over its parse budget and showed plain text instead
+ */
+int64_t MDTextLabel::get_budget_fallback_count() {
+	return (int64_t)_budget_fallback_count.load(std::memory_order_relaxed);
 }
 
 
 String MDTextLabel::get_markdown() const {
-	return markdown;
+	if (!_markdown_valid) {
+		_markdown = String::utf8(_source.get_data(), _source.size());
+		_markdown_valid = true;
+	}
+	return _markdown;
 }
 
 void MDTextLabel::set_format(const Ref<MD2BBFormat> format) {
@@ -102,304 +338,233 @@ Ref<MD2BBFormat> MDTextLabel::get_format() const {
 	return format;
 }
 
+/**
+ * Shared link reference definitions, used from the next parse on
+ */
+void MDTextLabel::set_reference_library(const Ref<MDRefLibrary>& library) {
+	reference_library = library;
+}
+
+Ref<MDRefLibrary> MDTextLabel::get_reference_library() const {
+	return reference_library;
+}
+
+/**
+ * Scroll to the heading with the given slug, e.g. "getting-started" or "#getting-started".
+ * Returns false if no heading has that slug.
+ */
+bool MDTextLabel::scroll_to_anchor(const String& slug) {
+	int paragraph = get_anchor_paragraph(slug);
+	if (paragraph < 0)
+		return false;
+	scroll_to_paragraph(paragraph);
+	return true;
+}
+
+int MDTextLabel::get_anchor_paragraph(const String& slug) const {
+	const int* index = _anchor_lookup.getptr(slug.begins_with("#") ? slug.substr(1) : slug);
+	if (index == nullptr)
+		return -1;
+	return _anchors[*index].paragraph;
+}
+
+/**
+ * Slugs of all headings in document order, e.g. for building a table of contents
+ */
+PackedStringArray MDTextLabel::get_anchor_slugs() const {
+	return _anchor_slugs;
+}
+
+/**
+ * Number of RichTextLabel items (tag pushes, text runs and images) the last parse created.
+ * Each one costs a call into the engine and layout work, so this tracks rendering cost.
+ */
+int MDTextLabel::get_rendered_item_count() const {
+	return _rendered_item_count;
+}
+
+/**
+ * What the last parse produced and cost, see md_stats_to_dictionary(). Also filled in when the markdown went over the
+ * parse budget, up to the point where it stopped.
+ */
+Dictionary MDTextLabel::get_parse_stats() const {
+	return md_stats_to_dictionary(_parse_stats, _rendered_item_count);
+}
+
+/**
+ * Keys: blocks, spans, text_runs, links, images, tables and max_depth count md4c's events. usec is the wall time of
+ * the render. alloc_block_bytes, alloc_container_bytes, alloc_mark_bytes and alloc_buffer_bytes are md4c's peak
+ * buffer sizes, ref_library_lookups and ref_library_hits its use of the MDRefLibrary. items is only in
+ * MDTextLabel's, see MDTextLabel.get_rendered_item_count().
+ */
+Dictionary godot::md_stats_to_dictionary(const MDDocumentStats& stats, int items) {
+	Dictionary result;
+	result["blocks"] = stats.blocks;
+	result["spans"] = stats.spans;
+	result["text_runs"] = stats.text_runs;
+	result["links"] = stats.links;
+	result["images"] = stats.images;
+	result["tables"] = stats.tables;
+	result["max_depth"] = stats.max_depth;
+	result["usec"] = stats.usec;
+	result["alloc_block_bytes"] = stats.md4c.alloc_block_bytes;
+	result["alloc_container_bytes"] = stats.md4c.alloc_container_bytes;
+	result["alloc_mark_bytes"] = stats.md4c.alloc_mark_bytes;
+	result["alloc_buffer_bytes"] = stats.md4c.alloc_buffer_bytes;
+	result["ref_library_lookups"] = stats.md4c.ref_library_lookups;
+	result["ref_library_hits"] = stats.md4c.ref_library_hits;
+	if (items >= 0)
+		result["items"] = items;
+	return result;
+}
+
+/**
+ * Find the rendered block containing a byte offset of the UTF-8 encoded markdown.
+ * Blocks cover the whole lines they are written on, so offsets of markup such as # or list markers are found too.
+ * Returns an empty Dictionary if the offset is not inside any block.
+ */
+Dictionary MDTextLabel::get_block_at_offset(int byte_offset) const {
+	Dictionary block;
+	// Binary search for the last block starting at or before the offset
+	int lo = 0;
+	int hi = (int)_anchors.size();
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (_anchors[mid].source_begin <= byte_offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo == 0)
+		return block;
+	const MDBlockAnchor& anchor = _anchors[lo - 1];
+	if (byte_offset >= anchor.source_end)
+		return block;
+	block["paragraph"] = anchor.paragraph;
+	block["source_begin"] = anchor.source_begin;
+	block["source_end"] = anchor.source_end;
+	block["slug"] = anchor.slug_index >= 0 ? _anchor_slugs[anchor.slug_index] : String();
+	return block;
+}
+
 
-int MDTextLabel::_handle_md_block(MD_BLOCKTYPE block_type, void* detail, MD2BBFormat* md_data, bool exiting) {
-    switch (block_type) {
-		case MD_BLOCK_DOC:
-			// No BBCode equivalent
-			return MD_OK;
-		case MD_BLOCK_QUOTE:
-			// No BBCode equivalent
-			break;
-		case MD_BLOCK_UL:
-			__POP_IF_EXIT
-			{
-				MD_BLOCK_UL_DETAIL* ul_detail = (MD_BLOCK_UL_DETAIL*)detail;
-				push_list(0, ListType::LIST_DOTS, false, _mdchar_to_string(&ul_detail->mark, 1));
-			}
-			break;
-		case MD_BLOCK_OL:
-			__POP_IF_EXIT
-			{
-				MD_BLOCK_OL_DETAIL* ol_detail = (MD_BLOCK_OL_DETAIL*)detail;
-				push_list(0, ListType::LIST_NUMBERS, false, _mdchar_to_string(&ol_detail->mark_delimiter, 1));
-			}
-			break;
+/**
+ * Blocks recorded in the anchor map. Quotes are not recorded themselves, only the blocks inside them.
+ * List items are recorded whole, as the text of a tight list is in no other block.
+ */
+bool MDTextLabel::_is_anchor_block(MD_BLOCKTYPE block_type) {
+	switch (block_type) {
 		case MD_BLOCK_LI:
-			// BBCode list items are just separated by newlines
-			if (exiting) {
-				add_text("\n");
-			}
-			break;
-		case MD_BLOCK_HR:
-			add_text("\n");
-			break;
 		case MD_BLOCK_H:
-			return _handle_md_header(detail, md_data, exiting);
-			break;
+		case MD_BLOCK_P:
 		case MD_BLOCK_CODE:
-			// TODO: potentially differentiate fenced codeblocks from indented codeblocks?
-			__POP_IF_EXIT
-			push_mono();
-			break;
 		case MD_BLOCK_HTML:
-			WARN_PRINT("[MDTextLabel] HTML rendering is not supported by Godot. HTML will be rendered in a code block instead.");
-			push_mono();
-			break;
-		case MD_BLOCK_P:
-			push_paragraph(HORIZONTAL_ALIGNMENT_LEFT);
-			break;
 		case MD_BLOCK_TABLE:
-			// Formatting for table cells is set at table head and table body
-			__POP_IF_EXIT
-			{
-				MD_BLOCK_TABLE_DETAIL* table_detail = (MD_BLOCK_TABLE_DETAIL*)detail;
-				push_table(table_detail->col_count);
-			}
-			break;
-		case MD_BLOCK_THEAD:
-			__POP_IF_EXIT
-			{
-				Ref<MD2BBCellFormat> head_format = md_data->table_head_format;
-				_set_md_cell_format(head_format);
-			}
-			break;
-		case MD_BLOCK_TBODY:
-			__POP_IF_EXIT
-			{
-				Ref<MD2BBCellFormat> body_format = md_data->table_body_format;
-				_set_md_cell_format(body_format);
-			}
-			break;
-		case MD_BLOCK_TR:
-			// No BBCode equivalent
-			break;
-		case MD_BLOCK_TH:
-			__POP_IF_EXIT
-			push_cell();
-			break;
-		case MD_BLOCK_TD:
-			__POP_IF_EXIT
-			push_cell();
-			break;
+		case MD_BLOCK_HR:
+			return true;
 		default:
-			ERR_PRINT("[MDTextLabel] Unrecognized markdown block type: " + block_type);
-			return BAD_BLOCK;
+			return false;
 	}
+}
 
-	return MD_OK;
-}
-
-int MDTextLabel::_handle_md_span(MD_SPANTYPE span_type, void* detail, MD2BBFormat* md_data, bool exiting) {
-    switch (span_type) {
-        case MD_SPAN_EM:
-            __POP_IF_EXIT
-			push_italics();
-            break;
-        case MD_SPAN_STRONG:
-			__POP_IF_EXIT
-			push_bold();
-            break;
-        case MD_SPAN_A:
-            return _handle_md_link(detail, md_data, exiting);
-            break;
-        case MD_SPAN_IMG:
-			// Image push and pop is done in one step - so don't pop on exit again
-			if (exiting)
-				break;
-			{
-				MD_SPAN_IMG_DETAIL* img_detail = (MD_SPAN_IMG_DETAIL*)detail;
-				// Appending the image bbcode here as a string is easier than trying to re-write the image fetching code ourselves
-				append_text("[img]" + _mdattr_to_string(img_detail->src) + "[/img]");
-			}
-            break;
-        case MD_SPAN_CODE:
-			__POP_IF_EXIT
-            push_mono();
-            break;
-        case MD_SPAN_DEL:
-        	__POP_IF_EXIT
-			push_strikethrough();
-            break;
-        case MD_SPAN_LATEXMATH:
-            ERR_PRINT("[MDTextLabel] LATEX rendering is not supported by Godot.");
-            return BAD_SPAN;
-            break;
-        case MD_SPAN_LATEXMATH_DISPLAY:
-            ERR_PRINT("[MDTextLabel] LATEX rendering is not supported by Godot.");
-            return BAD_SPAN;
-        case MD_SPAN_WIKILINK:
-            return _handle_md_wikilink(detail, md_data, exiting);
-            break;
-        case MD_SPAN_U:
-			__POP_IF_EXIT
-			push_underline();
-            break;
-        default:
-            ERR_PRINT("[MDTextLabel] Unrecognized markdown span type: " + span_type);
-            return BAD_BLOCK;
-	}
-	return MD_OK;
-}
-
-int MDTextLabel::_handle_md_text(MD_TEXTTYPE text_type, const MD_CHAR* text, MD_SIZE size, MD2BBFormat* md_data) {
-    switch (text_type) {
-        case MD_TEXT_NORMAL:
-            add_text(_mdchar_to_string(text, size));
-            break;
-        case MD_TEXT_CODE:
-            add_text(_mdchar_to_string(text, size));
-            break;
-        case MD_TEXT_NULLCHAR:
-            break;
-        case MD_TEXT_BR:
-            add_text("\n");
-            break;
-        case MD_TEXT_SOFTBR:
-			add_text("\n");
-            break;
-        case MD_TEXT_ENTITY:
-            add_text(_mdchar_to_string(text, size));
-            break;
-        case MD_TEXT_HTML:
-            // Not supported
-            break;
-        case MD_TEXT_LATEXMATH:
-            // Not supported
-            break;
-        default:
-            ERR_PRINT("[MDTextLabel] Unrecognized markdown text type: " + text_type);
-            break;
-    }  
-    
-    return MD_OK;
+void MDTextLabel::_clear_anchors() {
+	_anchors.clear();
+	_anchor_slugs.clear();
+	_anchor_lookup.clear();
+	_current_anchor = -1;
+	_anchor_block_depth = 0;
+	_in_heading = false;
+	_heading_text = String();
 }
 
-/**
- * Handle a header block, using header format settings in MD2BBHeaderFormat
- */
-int MDTextLabel::_handle_md_header(void* detail, MD2BBFormat* md_data, bool exiting) {
-    unsigned level = ((MD_BLOCK_H_DETAIL*)detail)->level;
-    Ref<MD2BBHeaderFormat> header_format;
-    switch (level) {
-        case 1:
-            header_format = md_data->h1_format;
-            break;
-        case 2:
-            header_format = md_data->h2_format;
-            break;
-        case 3:
-            header_format = md_data->h3_format;
-            break;
-        case 4:
-            header_format = md_data->h4_format;
-            break;
-        case 5:
-            header_format = md_data->h5_format;
-            break;
-        case 6:
-            header_format = md_data->h6_format;
-            break;
-        default:
-            return BAD_HEADER_SIZE;
-    }
-    if (!exiting) {
-        float size = header_format->font_size;
-        push_font_size(size);
-        if (header_format->bold) {
-            push_bold();
-        }
-        if (header_format->italic) {
-            push_italics();
-        }
-        if (header_format->underlined) {
-            push_underline();
-        }
-        if (header_format->has_color) {
-            push_color(header_format->font_color);
-        }
-    } else {
-        if (header_format->has_color)
-            pop();
-		if (header_format->underlined)
-			pop();
-		if (header_format->italic)
-			pop();
-		if (header_format->bold)
-			pop();
-		// font size tag
-		pop();
-        add_text("\n");
-    }
-    return MD_OK;
+void MDTextLabel::_begin_anchor_block() {
+	// Only the outermost block is recorded, e.g. a table but not its cells
+	if (_anchor_block_depth++ > 0)
+		return;
+	MDBlockAnchor anchor;
+	anchor.paragraph = MAX(get_paragraph_count() - 1, 0);
+	anchor.source_begin = -1;
+	anchor.source_end = -1;
+	anchor.slug_index = -1;
+	_current_anchor = _anchors.size();
+	_anchors.push_back(anchor);
+}
+
+void MDTextLabel::_end_anchor_block() {
+	if (_anchor_block_depth == 0 || --_anchor_block_depth > 0)
+		return;
+	// Blocks without any source text (e.g. horizontal rules) can't be located by offset, so aren't kept
+	if (_anchors[_current_anchor].source_begin < 0)
+		_anchors.resize(_current_anchor);
+	_current_anchor = -1;
 }
 
 /**
- * Handles a spans - and whether to include text label or not
+ * A heading inside a list item gets its slug too, pointing at the item
  */
-int MDTextLabel::_handle_md_link(void* detail, MD2BBFormat* md_data, bool exiting) {
-    /*MD_SPAN_A_DETAIL* link_detail = (MD_SPAN_A_DETAIL*)detail;
-    if (!exiting) {
-        if (link_detail->title.size > 0) {
-            md_data->output += "[hint=" + _mdattr_to_string(link_detail->title) + "]";
-        }
-        md_data->output += "[url=" + _mdattr_to_string(link_detail->href) + "]" + _mdattr_to_string(link_detail->title) + "[/url]";
-    } else {
-        md_data->output += "[/url]";
-        if (link_detail->title.size > 0) {
-            md_data->output += "[/hint]";
-        }
-    }*/
-    return MD_OK;
-}
-
-int MDTextLabel::_handle_md_wikilink(void* detail, MD2BBFormat* md_data, bool exiting) {
-    ERR_PRINT("[MDTextLabel] Wikilinks are not yet supported. Use normal links with filepaths instead.");
-    return BAD_SPAN;
+void MDTextLabel::_end_heading() {
+	_in_heading = false;
+	if (_current_anchor >= 0 && _anchors[_current_anchor].source_begin >= 0)
+		_add_heading_slug(_heading_text);
 }
 
 /**
- * Apply a table cell format, affecting all consequent cells
+ * Widen every block's source range from its text to the lines it is written on, once the next block is known
  */
-void MDTextLabel::_set_md_cell_format(Ref<MD2BBCellFormat> format) {
-	set_cell_border_color(format->border_color);
-	set_cell_padding(format->padding);
-	set_cell_row_background_color(format->row_bg_odd, format->row_bg_even);
-	if (format->size_override) {
-		set_cell_size_override(format->min_size_override, format->max_size_override);
-	} else {
-		set_cell_size_override(Vector2(), Vector2());
+void MDTextLabel::_finish_anchors() {
+	for (uint32_t i = 0; i < _anchors.size(); i++) {
+		MDBlockAnchor& anchor = _anchors[i];
+		int min_begin = i > 0 ? _anchors[i - 1].source_end : 0;
+		int next_begin = i + 1 < _anchors.size() ? _anchors[i + 1].source_begin : (int)_parse_source_size;
+		md_widen_source_range(_parse_source, _parse_source_size, min_begin, next_begin, anchor.source_begin, anchor.source_end);
 	}
 }
 
-
 /**
- * Convert a md4c char array to a godot String.
- * md4c does not guarantee to provide null-terminated strings, so needs extra work to convert
+ * Extend the current block's source range to cover a text run.
+ * Text that md4c had to build in its own buffers does not point into the source and is ignored.
  */
-String MDTextLabel::_mdchar_to_string(const MD_CHAR* text, MD_SIZE size) {
-    // Double check char array isnt already null-terminated
-    if (text[size - 1] == '\0')
-        return String(text);
-    // Create new char array for null termination
-    // Avoid realloc as md4c handles freeing it's own char pointers
-    MD_CHAR* null_terminated_text = (MD_CHAR*)memalloc(size + 1);
-    strncpy(null_terminated_text, text, size);
-    null_terminated_text[size] = '\0';
-    String str(null_terminated_text);
-    memfree(null_terminated_text);
-    return str;
+void MDTextLabel::_track_anchor_text(const MD_CHAR* text, MD_SIZE size) {
+	if (_current_anchor < 0 || text < _parse_source || text + size > _parse_source + _parse_source_size)
+		return;
+	MDBlockAnchor& anchor = _anchors[_current_anchor];
+	int begin = (int)(text - _parse_source);
+	if (anchor.source_begin < 0)
+		anchor.source_begin = begin;
+	anchor.source_end = MAX(anchor.source_end, begin + (int)size);
+}
+
+void MDTextLabel::_add_heading_slug(const String& heading) {
+	String base = _make_slug(heading);
+	String slug = base;
+	// Duplicate headings get numbered suffixes, as on GitHub
+	for (int i = 1; _anchor_lookup.has(slug); i++) {
+		slug = base + "-" + String::num_int64(i);
+	}
+	_anchors[_current_anchor].slug_index = _anchor_slugs.size();
+	_anchor_slugs.push_back(slug);
+	_anchor_lookup[slug] = _current_anchor;
 }
 
 /**
- * Shortcut function for MD_ATTRIBUTE
+ * GitHub style heading slug: lowercase, spaces become hyphens, punctuation is dropped
  */
-String MDTextLabel::_mdattr_to_string(MD_ATTRIBUTE attr) {
-    return _mdchar_to_string(attr.text, attr.size);
+String MDTextLabel::_make_slug(const String& heading) {
+	String lower = heading.strip_edges().to_lower();
+	String slug;
+	for (int i = 0; i < lower.length(); i++) {
+		char32_t c = lower[i];
+		if (c == ' ' || c == '\t' || c == '\n') {
+			slug += U'-';
+		} else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c > 127) {
+			slug += c;
+		}
+	}
+	return slug;
 }
 
 
-
 // =============== RESOURCE DEFINITIONS ====================
 
 void MD2BBFormat::_bind_methods() {
@@ -432,6 +597,45 @@ void MD2BBFormat::_bind_methods() {
 
 }
 
+void MD2BBFormat::get_render_style(MDRenderStyle& r_style) const {
+	const Ref<MD2BBHeaderFormat> header_formats[6] = { h1_format, h2_format, h3_format, h4_format, h5_format, h6_format };
+	for (int i = 0; i < 6; i++) {
+		r_style.headers[i] = MDHeaderStyle();
+		if (header_formats[i].is_valid())
+			header_formats[i]->get_render_style(r_style.headers[i]);
+	}
+	r_style.table_head = MDCellStyle();
+	if (table_head_format.is_valid())
+		table_head_format->get_render_style(r_style.table_head);
+	r_style.table_body = MDCellStyle();
+	if (table_body_format.is_valid())
+		table_body_format->get_render_style(r_style.table_body);
+}
+
+void MD2BBHeaderFormat::get_render_style(MDHeaderStyle& r_style) const {
+	r_style.font_size = font_size;
+	r_style.bold = bold;
+	r_style.italic = italic;
+	r_style.underlined = underlined;
+	r_style.has_color = has_color;
+	r_style.font_color = { font_color.r, font_color.g, font_color.b, font_color.a };
+}
+
+void MD2BBCellFormat::get_render_style(MDCellStyle& r_style) const {
+	r_style.border_color = { border_color.r, border_color.g, border_color.b, border_color.a };
+	r_style.padding[0] = padding.position.x;
+	r_style.padding[1] = padding.position.y;
+	r_style.padding[2] = padding.size.x;
+	r_style.padding[3] = padding.size.y;
+	r_style.row_bg_odd = { row_bg_odd.r, row_bg_odd.g, row_bg_odd.b, row_bg_odd.a };
+	r_style.row_bg_even = { row_bg_even.r, row_bg_even.g, row_bg_even.b, row_bg_even.a };
+	r_style.size_override = size_override;
+	r_style.min_size_override[0] = min_size_override.x;
+	r_style.min_size_override[1] = min_size_override.y;
+	r_style.max_size_override[0] = max_size_override.x;
+	r_style.max_size_override[1] = max_size_override.y;
+}
+
 void MD2BBHeaderFormat::_bind_methods() {
 
     ClassDB::bind_method(D_METHOD("get_font_size"), &MD2BBHeaderFormat::get_font_size);
@@ -1,15 +1,17 @@
 #ifndef GDEXAMPLE_H
 #define GDEXAMPLE_H
 
-#include "md4c.h"
+#include "md_ref_library.h"
+#include "md_renderer.h"
+#include "md_source_buffer.h"
 
 #include <godot_cpp/classes/rich_text_label.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 
-namespace godot {
+#include <atomic>
 
-enum MD2BBError {
-	MD_OK=0, BAD_BLOCK=1, BAD_SPAN=2, BAD_HEADER_SIZE=3
-};
+namespace godot {
 
 class MD2BBHeaderFormat : public Resource {
 	GDCLASS(MD2BBHeaderFormat, Resource);
@@ -35,6 +37,8 @@ public:
 	Color get_font_color() const { return font_color; }
 	void set_font_color(Color value) { font_color = value; }
 
+	void get_render_style(MDHeaderStyle& r_style) const;
+
 protected:
 	static void _bind_methods();
 };
@@ -51,6 +55,8 @@ public:
 	Vector2 min_size_override;
 	Vector2 max_size_override;
 
+	void get_render_style(MDCellStyle& r_style) const;
+
 protected:
 	static void _bind_methods() {}
 };
@@ -90,11 +96,32 @@ public:
 	Ref<MD2BBCellFormat> get_table_body_format () const { return table_body_format; }
 	void set_table_body_format (Ref<MD2BBCellFormat> value) { table_body_format = value; }
 
+	// Snapshot for MDRenderer. Missing sub-formats fall back to unstyled output
+	void get_render_style(MDRenderStyle& r_style) const;
+
 protected:
 	static void _bind_methods();
 
 };
 
+// md4c allocator routed through Godot's memalloc, so parser memory is counted by the engine's memory monitors
+extern const MD_ALLOCATOR MD_GODOT_ALLOCATOR;
+
+// The get_parse_stats() Dictionary of MDTextLabel and MD2BB. items is only included when not negative
+Dictionary md_stats_to_dictionary(const MDDocumentStats& stats, int items = -1);
+
+/**
+ * A rendered block, recorded while parsing so anchors and source offsets can be looked up without scanning text.
+ * Source offsets are byte offsets into the UTF-8 encoded markdown.
+ */
+struct MDBlockAnchor {
+	int paragraph;
+	int source_begin;
+	int source_end;
+	// Index into MDTextLabel::_anchor_slugs, or -1 if the block is not a heading
+	int slug_index;
+};
+
 /**
  * RichTextLabel but with Markdown support, internally converts Markdown text into a bbcode tag stack
  */
@@ -102,43 +129,89 @@ class MDTextLabel : public RichTextLabel {
 	GDCLASS(MDTextLabel, RichTextLabel)
 
 public:
-	String markdown;
 	Ref<MD2BBFormat> format;
+	Ref<MDRefLibrary> reference_library;
+	// Limits for untrusted markdown. Over budget, the markdown is shown as plain text instead
+	MDParseBudget budget;
 
 private:
-	MD_PARSER* _md_parser;
-    
-    // Callbacks for md_parse()
-    // Static so callback closures can access
-    int _handle_md_block(MD_BLOCKTYPE block_type, void* detail, MD2BBFormat* md_data, bool exiting);
-    int _handle_md_span(MD_SPANTYPE span_type, void* detail, MD2BBFormat* md_data, bool exiting);
-    int _handle_md_text(MD_TEXTTYPE text_type, const MD_CHAR* text, MD_SIZE size, MD2BBFormat* md_data);
-
-    // Tags with more complex behaviour than just tag replacement
-    int _handle_md_header(void* detail, MD2BBFormat* md_data, bool exiting);
-    int _handle_md_link(void* detail, MD2BBFormat* md_data, bool exiting);
-    int _handle_md_wikilink(void* detail, MD2BBFormat* md_data, bool exiting);
-
-	// BBCode format state helper functions
-	void _set_md_cell_format(Ref<MD2BBCellFormat> format);
-
-    // Utility functions
-    static String _mdchar_to_string (const MD_CHAR* text, MD_SIZE size);
-    static String _mdattr_to_string (MD_ATTRIBUTE attr);
+	friend class MDLabelSink;
+
+	// The document as md4c reads it. The markdown property is only decoded from it when asked for
+	MDSourceBuffer _source;
+	mutable String _markdown;
+	mutable bool _markdown_valid = true;
+
+	// Renders that fell back to plain text, over all labels
+	static std::atomic<uint64_t> _budget_fallback_count;
+
+	// Anchor map, rebuilt on every parse. Blocks are appended in document order so are sorted by source offset
+	LocalVector<MDBlockAnchor> _anchors;
+	PackedStringArray _anchor_slugs;
+	HashMap<String, int> _anchor_lookup;
+	// Document of the render in progress, from MDLabelSink::begin_document. Turns md4c text pointers into byte offsets
+	const MD_CHAR* _parse_source = nullptr;
+	MD_SIZE _parse_source_size = 0;
+	// Index into _anchors of the outermost block being rendered, or -1
+	int _current_anchor = -1;
+	int _anchor_block_depth = 0;
+	bool _in_heading = false;
+	String _heading_text;
+	// RichTextLabel items created by the last parse
+	int _rendered_item_count = 0;
+	MDDocumentStats _parse_stats;
+
+	// Anchor map helper functions
+	void _clear_anchors();
+	void _begin_anchor_block();
+	void _end_anchor_block();
+	void _end_heading();
+	void _finish_anchors();
+	void _track_anchor_text(const MD_CHAR* text, MD_SIZE size);
+	void _add_heading_slug(const String& heading);
+	static bool _is_anchor_block(MD_BLOCKTYPE block_type);
+	static String _make_slug(const String& heading);
 
 protected:
 	static void _bind_methods();
-	int _parse_markdown(String md_text);
+	int _parse_markdown();
+	// Lays the text out right away when tracing, to attribute RichTextLabel's layout to the update that caused it
+	void _trace_layout();
 	void _validate_property(PropertyInfo& property);
 
 public:
 	void set_markdown(String p_text);
 	void append_markdown(String p_text);
+	void set_markdown_utf8(const PackedByteArray& p_markdown);
+	void append_markdown_utf8(const PackedByteArray& p_markdown);
+	Error load_markdown_file(const String& path);
 	String get_markdown() const;
 
 	void set_format(const Ref<MD2BBFormat> format);
 	Ref<MD2BBFormat> get_format() const;
 
+	void set_reference_library(const Ref<MDRefLibrary>& library);
+	Ref<MDRefLibrary> get_reference_library() const;
+
+	int get_budget_max_bytes() const { return (int)budget.max_bytes; }
+	void set_budget_max_bytes(int value) { budget.max_bytes = (uint32_t)MAX(value, 0); }
+	int get_budget_max_depth() const { return (int)budget.max_depth; }
+	void set_budget_max_depth(int value) { budget.max_depth = (uint32_t)MAX(value, 0); }
+	int get_budget_max_marks() const { return (int)budget.max_marks; }
+	void set_budget_max_marks(int value) { budget.max_marks = (uint32_t)MAX(value, 0); }
+	int get_budget_max_items() const { return (int)budget.max_items; }
+	void set_budget_max_items(int value) { budget.max_items = (uint32_t)MAX(value, 0); }
+	int get_budget_max_usec() const { return (int)budget.max_usec; }
+	void set_budget_max_usec(int value) { budget.max_usec = (uint32_t)MAX(value, 0); }
+	static int64_t get_budget_fallback_count();
+
+	bool scroll_to_anchor(const String& slug);
+	int get_anchor_paragraph(const String& slug) const;
+	PackedStringArray get_anchor_slugs() const;
+	Dictionary get_block_at_offset(int byte_offset) const;
+	int get_rendered_item_count() const;
+	Dictionary get_parse_stats() const;
+
 	MDTextLabel();
 	~MDTextLabel();
 };
@@ -0,0 +1,119 @@
+#include "md_trace.h"
+
+#ifdef MD_TRACE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+
+struct MDTraceEvent {
+	const char* name;
+	uint64_t start_ns;
+	uint64_t duration_ns;
+};
+
+struct MDTraceOpenScope {
+	const char* name;
+	// 0 when tracing was disabled as the scope began, so its end isn't recorded either
+	uint64_t start_ns;
+};
+
+/**
+ * One thread's events. Only that thread writes, and publishes each event by bumping written.
+ * Buffers are never freed, as the dump may still read one after its thread ended.
+ */
+struct MDTraceBuffer {
+	MDTraceEvent events[MD_TRACE_CAPACITY];
+	std::atomic<uint64_t> written{ 0 };
+	uint32_t thread_id = 0;
+	MDTraceBuffer* next = nullptr;
+
+	MDTraceOpenScope open[MD_TRACE_MAX_DEPTH];
+	int depth = 0;
+};
+
+static std::atomic<bool> trace_enabled{ false };
+// Every buffer ever created, newest first. Only ever pushed to
+static std::atomic<MDTraceBuffer*> trace_buffers{ nullptr };
+static std::atomic<uint32_t> trace_thread_count{ 0 };
+static thread_local MDTraceBuffer* thread_buffer = nullptr;
+
+static const std::chrono::steady_clock::time_point trace_origin = std::chrono::steady_clock::now();
+
+static uint64_t _now_ns() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_origin).count();
+}
+
+static MDTraceBuffer* _get_thread_buffer() {
+	if (thread_buffer != nullptr)
+		return thread_buffer;
+	MDTraceBuffer* buffer = new MDTraceBuffer();
+	buffer->thread_id = trace_thread_count.fetch_add(1, std::memory_order_relaxed) + 1;
+	buffer->next = trace_buffers.load(std::memory_order_relaxed);
+	while (!trace_buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed)) {
+	}
+	thread_buffer = buffer;
+	return buffer;
+}
+
+void md_trace_set_enabled(int enabled) {
+	trace_enabled.store(enabled != 0, std::memory_order_relaxed);
+}
+
+int md_trace_is_enabled(void) {
+	return trace_enabled.load(std::memory_order_relaxed) ? 1 : 0;
+}
+
+void md_trace_begin(const char* name) {
+	bool enabled = trace_enabled.load(std::memory_order_relaxed);
+	// Threads that never traced anything don't get a buffer
+	if (!enabled && (thread_buffer == nullptr || thread_buffer->depth == 0))
+		return;
+	MDTraceBuffer* buffer = _get_thread_buffer();
+	if (buffer->depth < MD_TRACE_MAX_DEPTH)
+		buffer->open[buffer->depth] = { name, enabled ? _now_ns() : 0 };
+	buffer->depth++;
+}
+
+void md_trace_end(void) {
+	MDTraceBuffer* buffer = thread_buffer;
+	// Began while tracing was off and this thread had no open scopes
+	if (buffer == nullptr || buffer->depth == 0)
+		return;
+	buffer->depth--;
+	if (buffer->depth >= MD_TRACE_MAX_DEPTH)
+		return;
+	const MDTraceOpenScope& scope = buffer->open[buffer->depth];
+	if (scope.start_ns == 0 || !trace_enabled.load(std::memory_order_relaxed))
+		return;
+	uint64_t index = buffer->written.load(std::memory_order_relaxed);
+	buffer->events[index % MD_TRACE_CAPACITY] = { scope.name, scope.start_ns, _now_ns() - scope.start_ns };
+	buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void md_trace_clear(void) {
+	for (MDTraceBuffer* buffer = trace_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+		buffer->written.store(0, std::memory_order_relaxed);
+}
+
+void md_trace_write_json(MDStringBuilder& output) {
+	char line[256];
+	bool first = true;
+	output.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (MDTraceBuffer* buffer = trace_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+		uint64_t written = buffer->written.load(std::memory_order_acquire);
+		uint64_t begin = written > MD_TRACE_CAPACITY ? written - MD_TRACE_CAPACITY : 0;
+		for (uint64_t i = begin; i < written; i++) {
+			const MDTraceEvent& event = buffer->events[i % MD_TRACE_CAPACITY];
+			// Names are literals from this library, so they never need escaping
+			int size = snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"cat\":\"markdown\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					first ? "" : ",", event.name, buffer->thread_id, event.start_ns / 1000.0, event.duration_ns / 1000.0);
+			output.append(line, (size_t)size < sizeof(line) ? (size_t)size : sizeof(line) - 1);
+			first = false;
+		}
+	}
+	output.append("\n]}\n");
+}
+
+#endif
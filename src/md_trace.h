@@ -0,0 +1,84 @@
+#ifndef MD_TRACE_H
+#define MD_TRACE_H
+
+/*
+ * Optional scoped tracing of the parse and render phases, to find which one makes a document slow.
+ * Compiled in by building with `scons md_trace=yes`, which defines MD_TRACE. Otherwise every macro
+ * below expands to nothing, so the instrumented code is exactly as without it.
+ *
+ * When compiled in, nothing is recorded until md_trace_set_enabled(1). Each thread then logs into a
+ * ring buffer of its own holding its latest MD_TRACE_CAPACITY scopes, without any locking, and
+ * md_trace_write_json() dumps all threads as Chrome trace_event JSON, for chrome://tracing or
+ * https://ui.perfetto.dev.
+ *
+ * Plain C, as md4c.c is instrumented too. Scope names must be string literals, only their pointer
+ * is stored.
+ */
+
+#ifdef MD_TRACE
+
+#define MD_TRACE_CAPACITY 16384
+/* Deeper scopes are counted but not recorded */
+#define MD_TRACE_MAX_DEPTH 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void md_trace_set_enabled(int enabled);
+int md_trace_is_enabled(void);
+void md_trace_begin(const char* name);
+void md_trace_end(void);
+/* Forget every recorded scope. Scopes recorded by other threads at the same time may survive. */
+void md_trace_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define MD_TRACE_BEGIN(name) md_trace_begin(name)
+#define MD_TRACE_END() md_trace_end()
+
+#else
+
+#define MD_TRACE_BEGIN(name) ((void)0)
+#define MD_TRACE_END() ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+
+#ifdef MD_TRACE
+
+#include "md_string_builder.h"
+
+/**
+ * Traces the enclosing C++ scope, see MD_TRACE_SCOPE
+ */
+class MDTraceScope {
+public:
+	MDTraceScope(const char* name) { md_trace_begin(name); }
+	~MDTraceScope() { md_trace_end(); }
+	MDTraceScope(const MDTraceScope&) = delete;
+	MDTraceScope& operator=(const MDTraceScope&) = delete;
+};
+
+/**
+ * Appends the recorded scopes of all threads as a Chrome trace_event JSON document. Scopes that are
+ * being recorded while this runs may come out torn, so dump after the traced work is done.
+ */
+void md_trace_write_json(MDStringBuilder& output);
+
+#define MD_TRACE_CONCAT_(a, b) a##b
+#define MD_TRACE_CONCAT(a, b) MD_TRACE_CONCAT_(a, b)
+#define MD_TRACE_SCOPE(name) MDTraceScope MD_TRACE_CONCAT(_md_trace_scope_, __LINE__)(name)
+
+#else
+
+#define MD_TRACE_SCOPE(name) ((void)0)
+
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,64 @@
+#include "md_tracer.h"
+
+#include "md_trace.h"
+
+#include <godot_cpp/core/class_db.hpp>
+
+using namespace godot;
+
+void MDTracer::_bind_methods() {
+	ClassDB::bind_static_method("MDTracer", D_METHOD("is_available"), &MDTracer::is_available);
+	ClassDB::bind_static_method("MDTracer", D_METHOD("set_enabled", "enabled"), &MDTracer::set_enabled);
+	ClassDB::bind_static_method("MDTracer", D_METHOD("is_enabled"), &MDTracer::is_enabled);
+	ClassDB::bind_static_method("MDTracer", D_METHOD("clear"), &MDTracer::clear);
+	ClassDB::bind_static_method("MDTracer", D_METHOD("get_chrome_trace"), &MDTracer::get_chrome_trace);
+}
+
+/**
+ * Whether tracing was compiled into this build
+ */
+bool MDTracer::is_available() {
+#ifdef MD_TRACE
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Start or stop recording. Each thread keeps its latest scopes, older ones are overwritten.
+ */
+void MDTracer::set_enabled(bool enabled) {
+#ifdef MD_TRACE
+	md_trace_set_enabled(enabled ? 1 : 0);
+#else
+	ERR_FAIL_COND_MSG(enabled, "[MDTracer] Tracing isn't compiled into this build, rebuild with md_trace=yes.");
+#endif
+}
+
+bool MDTracer::is_enabled() {
+#ifdef MD_TRACE
+	return md_trace_is_enabled() != 0;
+#else
+	return false;
+#endif
+}
+
+void MDTracer::clear() {
+#ifdef MD_TRACE
+	md_trace_clear();
+#endif
+}
+
+/**
+ * Recorded scopes of every thread as Chrome trace_event JSON
+ */
+String MDTracer::get_chrome_trace() {
+#ifdef MD_TRACE
+	MDStringBuilder json;
+	md_trace_write_json(json);
+	return String::utf8(json.get_data(), (int)json.size());
+#else
+	return String();
+#endif
+}
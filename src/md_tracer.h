@@ -0,0 +1,28 @@
+#ifndef MD_TRACER_H
+#define MD_TRACER_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+
+namespace godot {
+
+/**
+ * Scripting access to the phase tracing of md_trace.h. Only records anything in builds made with `scons md_trace=yes`,
+ * check MDTracer.is_available(). Save the get_chrome_trace() JSON to a file and open it in chrome://tracing or Perfetto.
+ */
+class MDTracer : public RefCounted {
+	GDCLASS(MDTracer, RefCounted)
+
+protected:
+	static void _bind_methods();
+
+public:
+	static bool is_available();
+	static void set_enabled(bool enabled);
+	static bool is_enabled();
+	static void clear();
+	static String get_chrome_trace();
+};
+
+}
+
+#endif
@@ -1,14 +1,133 @@
 #include "register_types.h"
 
 #include "md_text_label.h"
+#include "md2bb.h"
+#include "md_batch.h"
+#include "md_ref_library.h"
+#include "md_monitors.h"
+#include "md_tracer.h"
 
 #include <gdextension_interface.h>
+#include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/performance.hpp>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/core/defs.hpp>
 #include <godot_cpp/godot.hpp>
 
 using namespace godot;
 
+/**
+ * Average per frame of one of MDMonitors' running totals, over the frames since the monitor was last read.
+ * Only the main thread reads monitors, so this state needs no synchronization.
+ */
+struct MDFrameAverage {
+	uint64_t last_total = 0;
+	uint64_t last_frame = 0;
+	double value = 0.0;
+
+	double sample(const std::atomic<uint64_t>& counter) {
+		uint64_t total = counter.load(std::memory_order_relaxed);
+		uint64_t frame = Engine::get_singleton()->get_process_frames();
+		// Read twice in the same frame, e.g. by the debugger and a script, the value must not drop to 0
+		if (frame != last_frame) {
+			value = (double)(total - last_total) / (double)(frame - last_frame);
+			last_total = total;
+			last_frame = frame;
+		}
+		return value;
+	}
+};
+
+/**
+ * Largest value one of MDMonitors' peaks reached since the monitor was last read. Taken and reset once per frame
+ * rather than on every read, for the same reason as MDFrameAverage.
+ */
+struct MDFramePeak {
+	uint64_t last_frame = 0;
+	int64_t value = 0;
+
+	int64_t sample(std::atomic<uint32_t>& peak) {
+		uint64_t frame = Engine::get_singleton()->get_process_frames();
+		if (frame != last_frame) {
+			value = peak.exchange(0, std::memory_order_relaxed);
+			last_frame = frame;
+		}
+		return value;
+	}
+};
+
+static MDFrameAverage parse_usec_average;
+static MDFrameAverage label_usec_average;
+static MDFrameAverage parsed_bytes_average;
+static MDFrameAverage label_items_average;
+static MDFramePeak block_bytes_peak;
+static MDFramePeak container_bytes_peak;
+static MDFramePeak mark_bytes_peak;
+static MDFramePeak buffer_bytes_peak;
+static uint64_t last_ref_library_lookups = 0;
+static uint64_t last_ref_library_hits = 0;
+static double ref_library_hit_rate = 0.0;
+
+static double _monitor_parse_usec() { return parse_usec_average.sample(MDMonitors::parse_usec); }
+static double _monitor_label_usec() { return label_usec_average.sample(MDMonitors::label_usec); }
+static double _monitor_parsed_bytes() { return parsed_bytes_average.sample(MDMonitors::parsed_bytes); }
+static double _monitor_label_items() { return label_items_average.sample(MDMonitors::label_items); }
+static int64_t _monitor_live_labels() { return MDMonitors::live_labels.load(std::memory_order_relaxed); }
+static int64_t _monitor_peak_block_bytes() { return block_bytes_peak.sample(MDMonitors::peak_block_bytes); }
+static int64_t _monitor_peak_container_bytes() { return container_bytes_peak.sample(MDMonitors::peak_container_bytes); }
+static int64_t _monitor_peak_mark_bytes() { return mark_bytes_peak.sample(MDMonitors::peak_mark_bytes); }
+static int64_t _monitor_peak_buffer_bytes() { return buffer_bytes_peak.sample(MDMonitors::peak_buffer_bytes); }
+
+// Share of the labels looked up in a MDRefLibrary that it resolved, since the last read.
+// Keeps the previous rate while nothing was looked up
+static double _monitor_ref_library_hit_rate() {
+	uint64_t lookups = MDMonitors::ref_library_lookups.load(std::memory_order_relaxed);
+	uint64_t hits = MDMonitors::ref_library_hits.load(std::memory_order_relaxed);
+	if (lookups != last_ref_library_lookups) {
+		ref_library_hit_rate = 100.0 * (double)(hits - last_ref_library_hits) / (double)(lookups - last_ref_library_lookups);
+		last_ref_library_lookups = lookups;
+		last_ref_library_hits = hits;
+	}
+	return ref_library_hit_rate;
+}
+
+struct MDMonitorDefinition {
+	const char* id;
+	Callable (*callable)();
+};
+
+static const MDMonitorDefinition MONITORS[] = {
+	{ "markdown/parse_usec_per_frame", []() { return callable_mp_static(&_monitor_parse_usec); } },
+	{ "markdown/label_update_usec_per_frame", []() { return callable_mp_static(&_monitor_label_usec); } },
+	{ "markdown/bytes_parsed_per_frame", []() { return callable_mp_static(&_monitor_parsed_bytes); } },
+	{ "markdown/items_pushed_per_frame", []() { return callable_mp_static(&_monitor_label_items); } },
+	{ "markdown/live_labels", []() { return callable_mp_static(&_monitor_live_labels); } },
+	{ "markdown/peak_block_buffer_bytes", []() { return callable_mp_static(&_monitor_peak_block_bytes); } },
+	{ "markdown/peak_container_buffer_bytes", []() { return callable_mp_static(&_monitor_peak_container_bytes); } },
+	{ "markdown/peak_mark_buffer_bytes", []() { return callable_mp_static(&_monitor_peak_mark_bytes); } },
+	{ "markdown/peak_aux_buffer_bytes", []() { return callable_mp_static(&_monitor_peak_buffer_bytes); } },
+	{ "markdown/ref_library_hit_rate_percent", []() { return callable_mp_static(&_monitor_ref_library_hit_rate); } },
+};
+
+static void _add_monitors() {
+	Performance* performance = Performance::get_singleton();
+	for (const MDMonitorDefinition& monitor : MONITORS) {
+		if (!performance->has_custom_monitor(monitor.id))
+			performance->add_custom_monitor(monitor.id, monitor.callable());
+	}
+}
+
+static void _remove_monitors() {
+	// The callables point into this library, so they must be gone before it is unloaded
+	Performance* performance = Performance::get_singleton();
+	if (performance == nullptr)
+		return;
+	for (const MDMonitorDefinition& monitor : MONITORS) {
+		if (performance->has_custom_monitor(monitor.id))
+			performance->remove_custom_monitor(monitor.id);
+	}
+}
+
 void initialize_godot_markdown_types(ModuleInitializationLevel p_level)
 {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
@@ -18,12 +137,18 @@ void initialize_godot_markdown_types(ModuleInitializationLevel p_level)
 	GDREGISTER_CLASS(MD2BBFormat);
 	GDREGISTER_CLASS(MD2BBHeaderFormat);
 	GDREGISTER_CLASS(MD2BBCellFormat);
+	GDREGISTER_CLASS(MD2BB);
+	GDREGISTER_CLASS(MDBatch);
+	GDREGISTER_CLASS(MDRefLibrary);
+	GDREGISTER_CLASS(MDTracer);
+	_add_monitors();
 }
 
 void uninitialize_godot_markdown_types(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+	_remove_monitors();
 }
 
 extern "C"